@@ -1,6 +1,16 @@
 #include "BinaryReader.h"
 #include <string>
-#include <fstream>
+#include <cstring>
+#include <ios>
+#include <utility>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 BinaryReader::BinaryReader()
 {
@@ -8,49 +18,257 @@ BinaryReader::BinaryReader()
 }
 BinaryReader::BinaryReader(std::string filePath)
 {
-	fd = std::ifstream(filePath, std::ios::binary | std::ios::in);
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart > 0x7FFFFFFF)
+	{
+		CloseHandle(file);
+		return;
+	}
+	hFile = file;
+	dataSize = (int)fileSize.QuadPart;
+	if (dataSize > 0) //empty files can't be mapped
+	{
+		hMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMapping == NULL)
+		{
+			Close();
+			return;
+		}
+		data = (const unsigned char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == NULL)
+		{
+			Close();
+			return;
+		}
+	}
+#else
+	int fd = open(filePath.c_str(), O_RDONLY);
+	if (fd == -1)
+		return;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size > 0x7FFFFFFF)
+	{
+		close(fd);
+		return;
+	}
+	dataSize = (int)st.st_size;
+	fileDevice = st.st_dev;
+	fileInode = st.st_ino;
+	if (dataSize > 0)
+	{
+		void* mapped = mmap(NULL, dataSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED)
+		{
+			close(fd);
+			dataSize = 0;
+			return;
+		}
+		data = (const unsigned char*)mapped;
+	}
+	fileDescriptor = fd;
+#endif
+	path = filePath;
+	bMapped = true;
 	bIsOpened = true;
 }
 
+BinaryReader::BinaryReader(const unsigned char* buffer, int bufferSize)
+{
+	if (buffer == nullptr && bufferSize != 0)
+		return;
+	data = buffer;
+	dataSize = bufferSize < 0 ? 0 : bufferSize;
+	bIsOpened = true;
+}
+
+BinaryReader::BinaryReader(BinaryReader&& other)
+{
+	*this = std::move(other);
+}
+
+BinaryReader& BinaryReader::operator=(BinaryReader&& other)
+{
+	if (this == &other)
+		return *this;
+	Close();
+	bIsOpened = other.bIsOpened;
+	bOutOfBounds = other.bOutOfBounds;
+	data = other.data;
+	dataSize = other.dataSize;
+	position = other.position;
+	path = std::move(other.path);
+	bMapped = other.bMapped;
+#ifdef _WIN32
+	hFile = other.hFile;
+	hMapping = other.hMapping;
+	other.hFile = nullptr;
+	other.hMapping = nullptr;
+#else
+	fileDevice = other.fileDevice;
+	fileInode = other.fileInode;
+	fileDescriptor = other.fileDescriptor;
+	other.fileDescriptor = -1;
+#endif
+	other.data = nullptr;
+	other.dataSize = 0;
+	other.position = 0;
+	other.bIsOpened = false;
+	other.bMapped = false;
+	return *this;
+}
+
+BinaryReader::~BinaryReader()
+{
+	Close();
+}
+
+void BinaryReader::Close()
+{
+#ifdef _WIN32
+	if (data != nullptr && bMapped)
+		UnmapViewOfFile(data);
+	if (hMapping != nullptr)
+		CloseHandle(hMapping);
+	if (hFile != nullptr)
+		CloseHandle(hFile);
+	hMapping = nullptr;
+	hFile = nullptr;
+#else
+	if (data != nullptr && bMapped)
+		munmap((void*)data, dataSize);
+	if (fileDescriptor != -1)
+		close(fileDescriptor);
+	fileDevice = 0;
+	fileInode = 0;
+	fileDescriptor = -1;
+#endif
+	data = nullptr;
+	dataSize = 0;
+	position = 0;
+	path.clear();
+	bMapped = false;
+	bIsOpened = false;
+	bOutOfBounds = false;
+}
+
+const std::string& BinaryReader::GetPath() const
+{
+	return path;
+}
+
+bool BinaryReader::IsSameFile(const std::string& otherPath) const
+{
+#ifdef _WIN32
+	if (hFile == nullptr)
+		return false;
+	//no access asked, so it opens even while the file is mapped or locked by someone else
+	HANDLE other = CreateFileA(otherPath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if (other == INVALID_HANDLE_VALUE)
+		return false;
+	BY_HANDLE_FILE_INFORMATION mine, theirs;
+	bool bSame = GetFileInformationByHandle(hFile, &mine) && GetFileInformationByHandle(other, &theirs) &&
+		mine.dwVolumeSerialNumber == theirs.dwVolumeSerialNumber && mine.nFileIndexHigh == theirs.nFileIndexHigh &&
+		mine.nFileIndexLow == theirs.nFileIndexLow;
+	CloseHandle(other);
+	return bSame;
+#else
+	if (path.empty())
+		return false;
+	struct stat st;
+	return stat(otherPath.c_str(), &st) == 0 && (unsigned long long)st.st_dev == fileDevice &&
+		(unsigned long long)st.st_ino == fileInode;
+#endif
+}
+
+int BinaryReader::GetDescriptor() const
+{
+#ifdef _WIN32
+	return -1;
+#else
+	return fileDescriptor;
+#endif
+}
+
+bool BinaryReader::CanRead(int count)
+{
+	if (count < 0 || position < 0 || position > dataSize - count)
+	{
+		bOutOfBounds = true;
+		return false;
+	}
+	return true;
+}
+
 void BinaryReader::ReadBuffer(char* c, int count)
 {
-	fd.read(c, count);
+	if (!CanRead(count))
+	{
+		if (count > 0)
+			memset(c, 0, count);
+		return;
+	}
+	memcpy(c, data + position, count);
+	position += count;
 }
 
 unsigned char BinaryReader::ReadByte()
 {
-	char local[1];
-	fd.read(local, 1);
-	return local[0];
+	if (!CanRead(1))
+		return 0;
+	return data[position++];
 }
 
 short BinaryReader::ReadInt16()
 {
-	char local[2];
-	fd.read(local, 2);
-	return *(short*)local;
+	if (!CanRead(2))
+		return 0;
+	const unsigned char* p = data + position;
+	position += 2;
+	return (short)(p[0] | (p[1] << 8));
 }
 
 unsigned long BinaryReader::ReadUInt32()
 {
-	char local[4];
-	fd.read(local, 4);
-	return *(unsigned long*)local;
+	if (!CanRead(4))
+		return 0;
+	const unsigned char* p = data + position;
+	position += 4;
+	return (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
 }
 
 int BinaryReader::ReadInt32()
 {
-	char local[4];
-	fd.read(local, 4);
-	return *(int*)local;
+	return (int)ReadUInt32();
 }
 
 void BinaryReader::seek(int offset, int mode)
 {
-	fd.seekg(offset, mode);
+	if (mode == std::ios::cur)
+		position += offset;
+	else if (mode == std::ios::end)
+		position = dataSize + offset;
+	else
+		position = offset;
 }
 
 int BinaryReader::tell()
 {
-	return fd.tellg();
-}
\ No newline at end of file
+	return position;
+}
+
+int BinaryReader::size() const
+{
+	return dataSize;
+}
+
+const unsigned char* BinaryReader::GetSpan(int offset, int count) const
+{
+	if (count < 0 || offset < 0 || offset > dataSize - count)
+		return nullptr;
+	return data + offset;
+}
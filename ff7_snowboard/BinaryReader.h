@@ -1,11 +1,22 @@
 #pragma once
-#include <fstream>
+#include <string>
+
+//Reader over whole file mapped into memory. All reads are little-endian and bounds checked-
+//reading past the end of file sets bOutOfBounds and returns zeroes instead of garbage
 class BinaryReader
 {
 public:
 	BinaryReader();
 	BinaryReader(std::string filePath);
+	//reader over bytes already in memory- they aren't copied nor freed, so they have to outlive the reader
+	BinaryReader(const unsigned char* buffer, int bufferSize);
+	BinaryReader(BinaryReader&& other);
+	BinaryReader& operator=(BinaryReader&& other);
+	BinaryReader(const BinaryReader&) = delete;
+	BinaryReader& operator=(const BinaryReader&) = delete;
+	~BinaryReader();
 	bool bIsOpened = false;
+	bool bOutOfBounds = false;
 	void ReadBuffer(char* c, int count);
 	short ReadInt16();
 	unsigned long ReadUInt32();
@@ -13,8 +24,33 @@ public:
 	unsigned char ReadByte();
 	void seek(int offset, int mode);
 	int tell();
+	int size() const;
+	//returns pointer to count bytes at offset inside the mapping or NULL if range is outside of file.
+	//Doesn't move the cursor nor touch bOutOfBounds so it's safe to call from many threads
+	const unsigned char* GetSpan(int offset, int count) const;
+	//path the reader was opened with
+	const std::string& GetPath() const;
+	//true if otherPath names the file this reader has opened, however it's spelled (relative, other case,
+	//other slashes, links). False for readers over memory and for files that don't exist
+	bool IsSameFile(const std::string& otherPath) const;
+	//descriptor the file is mapped through, open as long as the reader is- reads through it get bytes
+	//of this very file even if path was replaced since. -1 on Windows and for readers over memory
+	int GetDescriptor() const;
 
 private:
-	std::ifstream fd;
+	void Close();
+	bool CanRead(int count);
+	const unsigned char* data = nullptr;
+	int dataSize = 0;
+	int position = 0;
+	std::string path;
+	bool bMapped = false; //data is a file mapping this reader has to release
+#ifdef _WIN32
+	void* hFile = nullptr;
+	void* hMapping = nullptr;
+#else
+	unsigned long long fileDevice = 0; //identity of opened file for IsSameFile
+	unsigned long long fileInode = 0;
+	int fileDescriptor = -1;
+#endif
 };
-
@@ -0,0 +1,447 @@
+#include "Decimate.h"
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+//border planes weigh a lot more than surface planes so borders keep their shape
+static const double BORDER_WEIGHT = 1000.0;
+//tiny cost per edge length^4 (same units as area weighted quadric error). Flat areas cost 0 plus rounding
+//noise, without it the order is random and edges around one kept vertex win over and over until its
+//valence blows up and every collapse gets slower
+static const double LENGTH_WEIGHT = 1e-6;
+
+//symmetric 4x4 matrix of plane equations- xx xy xz xw yy yz yw zz zw ww
+struct quadric
+{
+	double a[10];
+};
+
+struct decimateEdge
+{
+	double cost;
+	int keep; //vertex that stays and moves to position
+	int remove; //vertex that is collapsed into keep
+	double position[3];
+	int keepVersion;
+	int removeVersion;
+	bool operator>(const decimateEdge& other) const { return cost > other.cost; }
+};
+
+struct decimateMesh
+{
+	std::vector<double> positions; //XYZ per vertex
+	std::vector<quadric> quadrics;
+	std::vector<char> bConstrained; //on color border, open border or non-manifold edge
+	std::vector<char> bAlive;
+	std::vector<int> versions; //bumped on every change, stale heap entries are skipped
+	std::vector<std::vector<int>> vertexPolygons;
+	std::vector<int> polygons; //3 vertex ids per polygon
+	std::vector<char> bPolygonAlive;
+	std::vector<float> colors; //RGB per corner
+	int livePolygons;
+	int liveVertices;
+};
+
+static void AddPlane(quadric& q, double nx, double ny, double nz, double d, double weight)
+{
+	q.a[0] += weight * nx * nx;
+	q.a[1] += weight * nx * ny;
+	q.a[2] += weight * nx * nz;
+	q.a[3] += weight * nx * d;
+	q.a[4] += weight * ny * ny;
+	q.a[5] += weight * ny * nz;
+	q.a[6] += weight * ny * d;
+	q.a[7] += weight * nz * nz;
+	q.a[8] += weight * nz * d;
+	q.a[9] += weight * d * d;
+}
+
+static double QuadricError(const quadric& q, const double* p)
+{
+	double x = p[0], y = p[1], z = p[2];
+	return q.a[0] * x * x + 2 * q.a[1] * x * y + 2 * q.a[2] * x * z + 2 * q.a[3] * x
+		+ q.a[4] * y * y + 2 * q.a[5] * y * z + 2 * q.a[6] * y
+		+ q.a[7] * z * z + 2 * q.a[8] * z + q.a[9];
+}
+
+//position with the smallest error, false if matrix is near singular (flat or straight neighbourhood)
+static bool QuadricMinimum(const quadric& q, double* p)
+{
+	const double* a = q.a;
+	double det = a[0] * (a[4] * a[7] - a[5] * a[5]) - a[1] * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * a[5] - a[4] * a[2]);
+	double trace = a[0] + a[4] + a[7];
+	if (trace <= 0.0 || fabs(det) <= 1e-9 * trace * trace * trace)
+		return false;
+	double bx = -a[3], by = -a[6], bz = -a[8];
+	p[0] = (bx * (a[4] * a[7] - a[5] * a[5]) - a[1] * (by * a[7] - a[5] * bz) + a[2] * (by * a[5] - a[4] * bz)) / det;
+	p[1] = (a[0] * (by * a[7] - bz * a[5]) - bx * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * bz - by * a[2])) / det;
+	p[2] = (a[0] * (a[4] * bz - a[5] * by) - a[1] * (a[1] * bz - by * a[2]) + bx * (a[1] * a[5] - a[4] * a[2])) / det;
+	return true;
+}
+
+static void PolygonNormal(const double* a, const double* b, const double* c, double* n)
+{
+	double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	double v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	n[0] = u[1] * v[2] - u[2] * v[1];
+	n[1] = u[2] * v[0] - u[0] * v[2];
+	n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+static const float* CornerColor(const decimateMesh& mesh, int polygon, int vertex)
+{
+	for (int k = 0; k < 3; k++)
+		if (mesh.polygons[polygon * 3 + k] == vertex)
+			return &mesh.colors[(polygon * 3 + k) * 3];
+	return nullptr;
+}
+
+static void LivePolygons(const decimateMesh& mesh, int vertex, std::vector<int>& out)
+{
+	out.clear();
+	for (int polygon : mesh.vertexPolygons[vertex])
+		if (mesh.bPolygonAlive[polygon])
+			out.push_back(polygon);
+}
+
+static void Neighbours(const decimateMesh& mesh, int vertex, std::vector<int>& out)
+{
+	out.clear();
+	for (int polygon : mesh.vertexPolygons[vertex])
+		if (mesh.bPolygonAlive[polygon])
+			for (int k = 0; k < 3; k++)
+				if (mesh.polygons[polygon * 3 + k] != vertex)
+					out.push_back(mesh.polygons[polygon * 3 + k]);
+	std::sort(out.begin(), out.end());
+	out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+static decimateEdge EvaluateEdge(const decimateMesh& mesh, int u, int v)
+{
+	quadric q = mesh.quadrics[u];
+	for (int i = 0; i < 10; i++)
+		q.a[i] += mesh.quadrics[v].a[i];
+	const double* pu = &mesh.positions[u * 3];
+	const double* pv = &mesh.positions[v * 3];
+	decimateEdge edge;
+	edge.keep = v;
+	edge.remove = u;
+	if (mesh.bConstrained[u] || mesh.bConstrained[v])
+	{
+		//constrained vertex can't move- the other one comes to it, or the cheaper way when both are
+		bool bKeepU = mesh.bConstrained[u] && (!mesh.bConstrained[v] || QuadricError(q, pu) < QuadricError(q, pv));
+		if (bKeepU)
+			std::swap(edge.keep, edge.remove);
+		memcpy(edge.position, &mesh.positions[edge.keep * 3], sizeof(edge.position));
+		edge.cost = QuadricError(q, edge.position);
+	}
+	else
+	{
+		double candidates[4][3] = {
+			{ pu[0], pu[1], pu[2] },
+			{ pv[0], pv[1], pv[2] },
+			{ (pu[0] + pv[0]) * 0.5, (pu[1] + pv[1]) * 0.5, (pu[2] + pv[2]) * 0.5 } };
+		int candidateCount = QuadricMinimum(q, candidates[3]) ? 4 : 3;
+		edge.cost = -1.0;
+		for (int i = 0; i < candidateCount; i++)
+		{
+			double error = QuadricError(q, candidates[i]);
+			if (edge.cost < 0.0 || error < edge.cost)
+			{
+				edge.cost = error;
+				memcpy(edge.position, candidates[i], sizeof(edge.position));
+			}
+		}
+	}
+	if (edge.cost < 0.0) //rounding
+		edge.cost = 0.0;
+	double length = (pu[0] - pv[0]) * (pu[0] - pv[0]) + (pu[1] - pv[1]) * (pu[1] - pv[1]) + (pu[2] - pv[2]) * (pu[2] - pv[2]);
+	edge.cost += LENGTH_WEIGHT * length * length;
+	edge.keepVersion = mesh.versions[edge.keep];
+	edge.removeVersion = mesh.versions[edge.remove];
+	return edge;
+}
+
+//checks collapse keeps mesh manifold, doesn't flip any polygon and moves borders only along themselves
+static bool CanCollapse(const decimateMesh& mesh, const decimateEdge& edge, std::vector<int>& scratchA, std::vector<int>& scratchB)
+{
+	int keep = edge.keep;
+	int remove = edge.remove;
+	std::vector<int> shared;
+	LivePolygons(mesh, remove, scratchA);
+	for (int polygon : scratchA)
+		if (mesh.polygons[polygon * 3] == keep || mesh.polygons[polygon * 3 + 1] == keep || mesh.polygons[polygon * 3 + 2] == keep)
+			shared.push_back(polygon);
+	if (shared.empty() || shared.size() > 2)
+		return false;
+	if (mesh.bConstrained[keep] && mesh.bConstrained[remove])
+	{
+		//both on a border- allowed only if the edge itself is the border: open edge or edge between colors
+		if (shared.size() == 2)
+		{
+			const float* keep0 = CornerColor(mesh, shared[0], keep);
+			const float* keep1 = CornerColor(mesh, shared[1], keep);
+			const float* remove0 = CornerColor(mesh, shared[0], remove);
+			const float* remove1 = CornerColor(mesh, shared[1], remove);
+			if (memcmp(keep0, keep1, 12) == 0 && memcmp(remove0, remove1, 12) == 0)
+				return false;
+		}
+	}
+
+	//link condition- vertices connected to both ends may only be the tips of shared polygons
+	Neighbours(mesh, keep, scratchA);
+	Neighbours(mesh, remove, scratchB);
+	int common = 0;
+	for (size_t i = 0, k = 0; i < scratchA.size() && k < scratchB.size();)
+	{
+		if (scratchA[i] < scratchB[k])
+			i++;
+		else if (scratchA[i] > scratchB[k])
+			k++;
+		else
+		{
+			common++;
+			i++;
+			k++;
+		}
+	}
+	if (common != (int)shared.size())
+		return false;
+
+	for (int end : { keep, remove })
+	{
+		LivePolygons(mesh, end, scratchA);
+		for (int polygon : scratchA)
+		{
+			if (std::find(shared.begin(), shared.end(), polygon) != shared.end())
+				continue;
+			const double* before[3];
+			const double* after[3];
+			for (int k = 0; k < 3; k++)
+			{
+				int vertex = mesh.polygons[polygon * 3 + k];
+				before[k] = &mesh.positions[vertex * 3];
+				after[k] = vertex == keep || vertex == remove ? edge.position : before[k];
+			}
+			double normalBefore[3];
+			double normalAfter[3];
+			PolygonNormal(before[0], before[1], before[2], normalBefore);
+			PolygonNormal(after[0], after[1], after[2], normalAfter);
+			double dot = normalBefore[0] * normalAfter[0] + normalBefore[1] * normalAfter[1] + normalBefore[2] * normalAfter[2];
+			if (dot <= 0.0)
+				return false;
+		}
+	}
+	return true;
+}
+
+static void Collapse(decimateMesh& mesh, const decimateEdge& edge)
+{
+	int keep = edge.keep;
+	int remove = edge.remove;
+	for (int polygon : mesh.vertexPolygons[remove])
+	{
+		if (!mesh.bPolygonAlive[polygon])
+			continue;
+		int* ids = &mesh.polygons[polygon * 3];
+		if (ids[0] == keep || ids[1] == keep || ids[2] == keep)
+		{
+			mesh.bPolygonAlive[polygon] = false;
+			mesh.livePolygons--;
+			continue;
+		}
+		for (int k = 0; k < 3; k++)
+			if (ids[k] == remove)
+				ids[k] = keep;
+		mesh.vertexPolygons[keep].push_back(polygon);
+	}
+	std::vector<int>& keptPolygons = mesh.vertexPolygons[keep];
+	keptPolygons.erase(std::remove_if(keptPolygons.begin(), keptPolygons.end(),
+		[&mesh](int polygon) { return !mesh.bPolygonAlive[polygon]; }), keptPolygons.end());
+	std::vector<int>().swap(mesh.vertexPolygons[remove]);
+
+	memcpy(&mesh.positions[keep * 3], edge.position, sizeof(edge.position));
+	for (int i = 0; i < 10; i++)
+		mesh.quadrics[keep].a[i] += mesh.quadrics[remove].a[i];
+	mesh.bConstrained[keep] = mesh.bConstrained[keep] || mesh.bConstrained[remove];
+	mesh.bAlive[remove] = false;
+	mesh.liveVertices--;
+	mesh.versions[keep]++;
+	mesh.versions[remove]++;
+}
+
+//corners at bitwise identical positions become one vertex
+static void BuildVertices(decimateMesh& mesh, const float* corners, int cornerCount)
+{
+	std::vector<int> order(cornerCount);
+	for (int i = 0; i < cornerCount; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [corners](int a, int b) {
+		return memcmp(corners + a * 6, corners + b * 6, 12) < 0;
+	});
+	mesh.polygons.resize(cornerCount);
+	int vertexCount = 0;
+	for (int i = 0; i < cornerCount; i++)
+	{
+		const float* corner = corners + order[i] * 6;
+		if (i == 0 || memcmp(corners + order[i - 1] * 6, corner, 12) != 0)
+		{
+			mesh.positions.insert(mesh.positions.end(), { corner[0], corner[1], corner[2] });
+			vertexCount++;
+		}
+		mesh.polygons[order[i]] = vertexCount - 1;
+	}
+	mesh.colors.resize(cornerCount * 3);
+	for (int i = 0; i < cornerCount; i++)
+		memcpy(&mesh.colors[i * 3], corners + i * 6 + 3, 12);
+	mesh.quadrics.assign(vertexCount, quadric());
+	mesh.bConstrained.assign(vertexCount, false);
+	mesh.bAlive.assign(vertexCount, true);
+	mesh.versions.assign(vertexCount, 0);
+	mesh.vertexPolygons.assign(vertexCount, std::vector<int>());
+	mesh.liveVertices = vertexCount;
+}
+
+int DecimateCorners(float* corners, int cornerCount, int targetPolygons, int targetVertices)
+{
+	int polygonCount = cornerCount / 3;
+	decimateMesh mesh;
+	BuildVertices(mesh, corners, polygonCount * 3);
+	auto bDone = [&]() {
+		return (targetPolygons <= 0 || mesh.livePolygons <= targetPolygons) && (targetVertices <= 0 || mesh.liveVertices <= targetVertices);
+	};
+	mesh.livePolygons = polygonCount;
+	if (bDone())
+		return cornerCount;
+
+	//1. surface quadrics, polygons that lost a corner to welding are dropped
+	mesh.bPolygonAlive.assign(polygonCount, true);
+	for (int i = 0; i < polygonCount; i++)
+	{
+		const int* ids = &mesh.polygons[i * 3];
+		if (ids[0] == ids[1] || ids[1] == ids[2] || ids[0] == ids[2])
+		{
+			mesh.bPolygonAlive[i] = false;
+			mesh.livePolygons--;
+			continue;
+		}
+		double n[3];
+		PolygonNormal(&mesh.positions[ids[0] * 3], &mesh.positions[ids[1] * 3], &mesh.positions[ids[2] * 3], n);
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		for (int k = 0; k < 3; k++)
+			mesh.vertexPolygons[ids[k]].push_back(i);
+		if (length == 0.0)
+			continue;
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+		const double* a = &mesh.positions[ids[0] * 3];
+		double d = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]);
+		for (int k = 0; k < 3; k++)
+			AddPlane(mesh.quadrics[ids[k]], n[0], n[1], n[2], d, length * 0.5);
+	}
+
+	//2. vertices whose corners have different colors sit on a color border
+	for (int i = 0; i < polygonCount; i++)
+	{
+		if (!mesh.bPolygonAlive[i])
+			continue;
+		for (int k = 0; k < 3; k++)
+		{
+			int vertex = mesh.polygons[i * 3 + k];
+			int first = mesh.vertexPolygons[vertex][0];
+			if (memcmp(CornerColor(mesh, first, vertex), &mesh.colors[(i * 3 + k) * 3], 12) != 0)
+				mesh.bConstrained[vertex] = true;
+		}
+	}
+
+	//3. edges- open and non-manifold ones are constrained and get planes holding them in place
+	std::unordered_map<unsigned long long, std::pair<int, int>> edges; //edge -> polygon using it, use count
+	edges.reserve(polygonCount * 2);
+	for (int i = 0; i < polygonCount; i++)
+	{
+		if (!mesh.bPolygonAlive[i])
+			continue;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int a = mesh.polygons[i * 3 + k];
+			unsigned int b = mesh.polygons[i * 3 + (k + 1) % 3];
+			unsigned long long key = a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+			auto inserted = edges.emplace(key, std::make_pair(i, 0));
+			inserted.first->second.second++;
+		}
+	}
+	std::priority_queue<decimateEdge, std::vector<decimateEdge>, std::greater<decimateEdge>> heap;
+	for (const auto& entry : edges)
+	{
+		int a = (int)(entry.first >> 32);
+		int b = (int)(entry.first & 0xFFFFFFFF);
+		if (entry.second.second != 2)
+		{
+			mesh.bConstrained[a] = true;
+			mesh.bConstrained[b] = true;
+			const int* ids = &mesh.polygons[entry.second.first * 3];
+			double n[3];
+			PolygonNormal(&mesh.positions[ids[0] * 3], &mesh.positions[ids[1] * 3], &mesh.positions[ids[2] * 3], n);
+			const double* pa = &mesh.positions[a * 3];
+			const double* pb = &mesh.positions[b * 3];
+			double e[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+			double border[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+			double length = sqrt(border[0] * border[0] + border[1] * border[1] + border[2] * border[2]);
+			if (length > 0.0)
+			{
+				for (int k = 0; k < 3; k++)
+					border[k] /= length;
+				double d = -(border[0] * pa[0] + border[1] * pa[1] + border[2] * pa[2]);
+				double weight = BORDER_WEIGHT * (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+				AddPlane(mesh.quadrics[a], border[0], border[1], border[2], d, weight);
+				AddPlane(mesh.quadrics[b], border[0], border[1], border[2], d, weight);
+			}
+		}
+	}
+	for (const auto& entry : edges)
+		heap.push(EvaluateEdge(mesh, (int)(entry.first >> 32), (int)(entry.first & 0xFFFFFFFF)));
+	std::unordered_map<unsigned long long, std::pair<int, int>>().swap(edges);
+
+	//4. collapse the cheapest edge until budget is met
+	std::vector<int> scratchA;
+	std::vector<int> scratchB;
+	std::vector<int> neighbours;
+	while (!bDone() && !heap.empty())
+	{
+		decimateEdge edge = heap.top();
+		heap.pop();
+		if (!mesh.bAlive[edge.keep] || !mesh.bAlive[edge.remove]
+			|| mesh.versions[edge.keep] != edge.keepVersion || mesh.versions[edge.remove] != edge.removeVersion)
+			continue;
+		if (!CanCollapse(mesh, edge, scratchA, scratchB))
+			continue;
+		Collapse(mesh, edge);
+		Neighbours(mesh, edge.keep, neighbours);
+		for (int neighbour : neighbours)
+			heap.push(EvaluateEdge(mesh, edge.keep, neighbour));
+	}
+
+	//5. write surviving polygons back as corners
+	int written = 0;
+	for (int i = 0; i < polygonCount; i++)
+	{
+		if (!mesh.bPolygonAlive[i])
+			continue;
+		for (int k = 0; k < 3; k++)
+		{
+			const double* position = &mesh.positions[mesh.polygons[i * 3 + k] * 3];
+			float* corner = corners + written * 6;
+			corner[0] = (float)position[0];
+			corner[1] = (float)position[1];
+			corner[2] = (float)position[2];
+			memcpy(corner + 3, &mesh.colors[(i * 3 + k) * 3], 12);
+			written++;
+		}
+	}
+	return written;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+//Quadric error (Garland-Heckbert) decimation of de-indexed XYZRGB corners (6 floats each, 3 per polygon),
+//same layout as vertices[] in main.cpp. Corners at identical positions are treated as one vertex.
+//Collapses edges until there are at most targetPolygons polygons and targetVertices distinct positions
+//(0 means no limit for that count) or nothing more can be collapsed without damage.
+//Color borders and open mesh borders are kept in place- vertices on them only slide along them, so
+//corner colors never bleed over a border. Result is written back to corners, returns new corner count
+int DecimateCorners(float* corners, int cornerCount, int targetPolygons, int targetVertices);
@@ -0,0 +1,108 @@
+#include "GpuMeshCache.h"
+#include "GL/gl3w.h"
+#include <iterator>
+
+GpuMeshCache::GpuMeshCache(size_t budgetBytes) : budget(budgetBytes)
+{
+}
+
+gpuMesh* GpuMeshCache::Find(int object, unsigned int version)
+{
+	for (auto mesh = meshes.begin(); mesh != meshes.end(); ++mesh)
+	{
+		if (mesh->object != object || mesh->version != version)
+			continue;
+		meshes.splice(meshes.begin(), meshes, mesh);
+		return &meshes.front();
+	}
+	return nullptr;
+}
+
+gpuMesh* GpuMeshCache::Insert(int object, unsigned int version)
+{
+	for (auto mesh = meshes.begin(); mesh != meshes.end();)
+	{
+		auto next = std::next(mesh);
+		if (mesh->object == object)
+			Delete(mesh);
+		mesh = next;
+	}
+	meshes.emplace_front();
+	gpuMesh& mesh = meshes.front();
+	mesh.object = object;
+	mesh.version = version;
+	glGenVertexArrays(1, &mesh.vao);
+	glGenBuffers(1, &mesh.vbo);
+	glGenBuffers(1, &mesh.ebo);
+	//layout is VAO state, so it's set once- later uploads only replace buffer contents
+	glBindVertexArray(mesh.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+	//position
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	//color
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glBindVertexArray(0);
+	return &mesh;
+}
+
+void GpuMeshCache::Trim()
+{
+	size_t used = UsedBytes();
+	while (used > budget && meshes.size() > 1)
+	{
+		used -= meshes.back().bytes;
+		Delete(std::prev(meshes.end()));
+	}
+}
+
+void GpuMeshCache::SetBudget(size_t budgetBytes)
+{
+	budget = budgetBytes;
+	Trim();
+}
+
+void GpuMeshCache::Invalidate(const gpuMesh* keep)
+{
+	for (auto mesh = meshes.begin(); mesh != meshes.end();)
+	{
+		auto next = std::next(mesh);
+		if (&*mesh != keep)
+			Delete(mesh);
+		mesh = next;
+	}
+}
+
+void GpuMeshCache::Remove(const gpuMesh* mesh)
+{
+	for (auto it = meshes.begin(); it != meshes.end(); ++it)
+	{
+		if (&*it != mesh)
+			continue;
+		Delete(it);
+		return;
+	}
+}
+
+int GpuMeshCache::Count() const
+{
+	return (int)meshes.size();
+}
+
+size_t GpuMeshCache::UsedBytes() const
+{
+	size_t used = 0;
+	for (const gpuMesh& mesh : meshes)
+		used += mesh.bytes;
+	return used;
+}
+
+void GpuMeshCache::Delete(std::list<gpuMesh>::iterator mesh)
+{
+	glDeleteVertexArrays(1, &mesh->vao);
+	glDeleteBuffers(1, &mesh->vbo);
+	glDeleteBuffers(1, &mesh->ebo);
+	meshes.erase(mesh);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <list>
+#include <cstddef>
+
+//one object on GPU- VAO with XYZRGB layout over its VBO and EBO
+struct gpuMesh
+{
+	unsigned int vao = 0;
+	unsigned int vbo = 0;
+	unsigned int ebo = 0;
+	int object = -1;
+	unsigned int version = 0; //0 is the object as decoded from file, every edit bumps it
+	bool bIndexed = false; //buffers hold indexed mesh, otherwise de-indexed corners
+	int drawCount = 0; //indices or corners
+	int indexedVertexCount = 0; //of last indexed build, for render stats
+	int indexCount = 0;
+	size_t bytes = 0; //of VBO and EBO
+};
+
+//Meshes of recently shown objects stay uploaded so going back to one is a bind instead of indexing and
+//uploading it again. Keyed by object index and edit version- an edited mesh never matches a lookup for
+//the file version of its object. Least recently used meshes are deleted once all of them take more than
+//budget bytes; the most recently used one is always kept. Needs current GL context for every call
+class GpuMeshCache
+{
+public:
+	GpuMeshCache(size_t budgetBytes);
+	//cached mesh made most recently used, or NULL
+	gpuMesh* Find(int object, unsigned int version);
+	//new most recently used mesh with empty buffers and vertex layout set up. Other versions of
+	//the same object are deleted- they can't be shown again
+	gpuMesh* Insert(int object, unsigned int version);
+	//call after buffers of mesh were (re)uploaded and its bytes updated
+	void Trim();
+	void SetBudget(size_t budgetBytes);
+	//deletes every mesh except keep (may be NULL)- object indices changed or bodies were rewritten
+	void Invalidate(const gpuMesh* keep);
+	//deletes mesh (may be NULL)- edited one once its object is closed, nothing can look it up again
+	void Remove(const gpuMesh* mesh);
+	int Count() const;
+	size_t UsedBytes() const;
+
+private:
+	void Delete(std::list<gpuMesh>::iterator mesh);
+	size_t budget;
+	std::list<gpuMesh> meshes; //most recently used first, pointers to them stay valid until deleted
+};
@@ -0,0 +1,158 @@
+#include "ImportJob.h"
+#include "MeshLoader.h"
+#include "Decimate.h"
+#include <algorithm>
+#include <new>
+
+//share of the progress bar for reading and post-processing, flattening and decimation get the rest
+static const float READ_SHARE = 0.7f;
+static const float FLATTEN_DONE = 0.8f;
+
+ImportJob::progressHandler::progressHandler(ImportJob& job) : job(job)
+{
+}
+
+//called by Assimp on the worker thread. Returning false asks the loader to abort
+bool ImportJob::progressHandler::Update(float percentage)
+{
+	if (percentage >= 0.0f)
+	{
+		float mapped = std::min(percentage, 1.0f) * READ_SHARE;
+		if (mapped > job.progress)
+			job.progress = mapped;
+	}
+	return !job.bCancel;
+}
+
+ImportJob::ImportJob(Assimp::Importer& importer) : importer(importer), handler(*this), bRunning(false), bDone(false),
+	bCancel(false), progress(0.0f), stage("")
+{
+	importer.SetProgressHandler(&handler);
+}
+
+ImportJob::~ImportJob()
+{
+	if (worker.joinable())
+	{
+		bCancel = true;
+		worker.join();
+	}
+	importer.SetProgressHandler(NULL); //handler is a member- takes it back so importer doesn't delete it
+}
+
+bool ImportJob::Start(const std::string& path, int preset, int polygonBudget, size_t maxCorners)
+{
+	if (bRunning)
+		return false;
+	if (worker.joinable())
+		worker.join();
+	result = importResult();
+	result.preset = preset;
+	bCancel = false;
+	bDone = false;
+	SetStage("Reading", 0.0f);
+	bRunning = true;
+	worker = std::thread(&ImportJob::Run, this, path, preset, polygonBudget, maxCorners);
+	return true;
+}
+
+bool ImportJob::IsRunning() const
+{
+	return bRunning;
+}
+
+bool ImportJob::IsDone() const
+{
+	return bDone;
+}
+
+float ImportJob::Progress() const
+{
+	return progress;
+}
+
+const char* ImportJob::Stage() const
+{
+	return stage;
+}
+
+void ImportJob::Cancel()
+{
+	bCancel = true;
+}
+
+importResult ImportJob::Finish()
+{
+	if (worker.joinable())
+		worker.join();
+	bRunning = false;
+	bDone = false;
+	if (bCancel)
+	{
+		//cancelled after worker was already past its last check
+		result.bCancelled = true;
+		result.bSuccess = false;
+	}
+	return std::move(result);
+}
+
+void ImportJob::SetStage(const char* name, float value)
+{
+	stage = name;
+	progress = value;
+}
+
+void ImportJob::Run(std::string path, int preset, int polygonBudget, size_t maxCorners)
+{
+	std::vector<float>& corners = result.corners;
+	try
+	{
+		//OBJ, PLY and STL are read natively, Assimp takes everything else and what they refuse
+		if (!LoadMeshFile(path, corners))
+		{
+			corners.clear();
+			result.bAssimp = true;
+			const aiScene* scene = ReadScene(importer, path, preset, result.report);
+			if (bCancel || scene == NULL || !scene->HasMeshes())
+			{
+				result.bCancelled = bCancel;
+				importer.FreeScene();
+				bDone = true;
+				return;
+			}
+			SetStage("Flattening", READ_SHARE);
+			SceneImport sceneImport(scene);
+			result.bNoColors = !sceneImport.HasColors();
+			if ((size_t)sceneImport.CornerCount() <= maxCorners)
+			{
+				corners.resize((size_t)sceneImport.CornerCount() * 6);
+				sceneImport.Flatten(corners.data());
+			}
+			importer.FreeScene(); //everything is in corners now
+		}
+		if (corners.size() / 6 > maxCorners)
+		{
+			result.bTooBig = true;
+			corners.clear();
+		}
+		else if (bCancel)
+			result.bCancelled = true;
+		else if (!corners.empty())
+		{
+			SetStage("Decimating", FLATTEN_DONE);
+			//TMD polygons index vertices with USHORT, so vertex count is always capped
+			int cornerCount = DecimateCorners(corners.data(), (int)(corners.size() / 6), polygonBudget, 0x10000);
+			corners.resize((size_t)cornerCount * 6);
+			result.bCancelled = bCancel;
+			result.bSuccess = !bCancel;
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		importer.FreeScene();
+		corners.clear();
+		result.bTooBig = true;
+	}
+	SetStage("Done", 1.0f);
+	bDone = true;
+}
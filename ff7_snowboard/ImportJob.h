@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SceneImport.h"
+#include "assimp/ProgressHandler.hpp"
+
+//what finished ImportJob hands over to the UI thread
+struct importResult
+{
+	bool bSuccess = false;
+	bool bCancelled = false;
+	bool bTooBig = false; //more corners than the caller allowed
+	bool bNoColors = false; //some Assimp mesh had neither material colors nor normals
+	bool bAssimp = false; //read through Assimp, report is filled
+	int preset = 0;
+	importReport report;
+	std::vector<float> corners; //decimated XYZRGB corners ready for vertices[]
+};
+
+//Runs whole model import (native loader or Assimp, flattening, decimation) on a worker thread so the
+//render loop keeps going. Assimp reports progress and is asked to abort through a ProgressHandler set on
+//importer for as long as the job lives, so importer mustn't be used elsewhere while IsRunning().
+//The UI thread polls IsDone() and takes result with Finish()- vertices[] is never touched by the worker.
+//Cancel stops Assimp where its loaders check for it and between stages otherwise
+class ImportJob
+{
+public:
+	ImportJob(Assimp::Importer& importer);
+	~ImportJob(); //cancels running import and waits for it
+	//false if an import is already running
+	bool Start(const std::string& path, int preset, int polygonBudget, size_t maxCorners);
+	//started and not yet taken with Finish
+	bool IsRunning() const;
+	bool IsDone() const;
+	float Progress() const; //0-1
+	const char* Stage() const;
+	void Cancel();
+	//waits for worker and moves result out
+	importResult Finish();
+
+private:
+	class progressHandler : public Assimp::ProgressHandler
+	{
+	public:
+		progressHandler(ImportJob& job);
+		bool Update(float percentage) override;
+	private:
+		ImportJob& job;
+	};
+	void Run(std::string path, int preset, int polygonBudget, size_t maxCorners);
+	void SetStage(const char* name, float progress);
+	Assimp::Importer& importer;
+	progressHandler handler;
+	std::thread worker;
+	std::atomic<bool> bRunning;
+	std::atomic<bool> bDone;
+	std::atomic<bool> bCancel;
+	std::atomic<float> progress;
+	std::atomic<const char*> stage;
+	importResult result;
+};
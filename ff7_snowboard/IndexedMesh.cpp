@@ -0,0 +1,43 @@
+#include "IndexedMesh.h"
+#include <cstring>
+
+void BuildIndexedMesh(const tmdObject& object, const float* cornerColors, int cornerStride, indexedMesh& mesh)
+{
+	int nVerts = (int)object.vertices.size();
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.vertices.reserve(nVerts * 6);
+	mesh.indices.reserve(object.polygon.size() * 3);
+
+	//every TMD vertex keeps a chain of GPU vertices made from it, one per distinct color.
+	//Most vertices have a single color so chains are short
+	std::vector<int> firstSplit(nVerts, -1);
+	std::vector<int> nextSplit;
+	nextSplit.reserve(nVerts);
+
+	for (size_t i = 0; i < object.polygon.size(); i++)
+	{
+		const TMD_3_NS_GP& poly = object.polygon[i];
+		if (poly.A >= nVerts || poly.B >= nVerts || poly.C >= nVerts)
+			continue;
+		unsigned short corners[3] = { poly.A, poly.B, poly.C };
+		for (int k = 0; k < 3; k++)
+		{
+			const float* color = cornerColors + (i * 3 + k) * cornerStride;
+			int position = corners[k];
+			int split = firstSplit[position];
+			while (split != -1 && memcmp(&mesh.vertices[split * 6 + 3], color, 3 * sizeof(float)) != 0)
+				split = nextSplit[split];
+			if (split == -1)
+			{
+				split = (int)nextSplit.size();
+				nextSplit.push_back(firstSplit[position]);
+				firstSplit[position] = split;
+				const vertex& v = object.vertices[position];
+				float xyzrgb[6] = { v.x, -v.y, v.z, color[0], color[1], color[2] };
+				mesh.vertices.insert(mesh.vertices.end(), xyzrgb, xyzrgb + 6);
+			}
+			mesh.indices.push_back(split);
+		}
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <vector>
+#include "Tmd.h"
+
+//Indexed XYZRGB mesh of TMD object. Positions are shared through element buffer and a TMD vertex is
+//split into more GPU vertices only when polygons touching it use different corner colors
+struct indexedMesh
+{
+	std::vector<float> vertices; //XYZRGB, same layout as de-indexed vertices[] in main.cpp
+	std::vector<unsigned int> indices;
+};
+
+//cornerColors points at RGB of first corner and is read with cornerStride floats step- corners follow
+//polygon order A, B, C. Polygons referencing missing vertices are skipped
+void BuildIndexedMesh(const tmdObject& object, const float* cornerColors, int cornerStride, indexedMesh& mesh);
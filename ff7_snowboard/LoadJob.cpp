@@ -0,0 +1,73 @@
+#include "LoadJob.h"
+#include <utility>
+
+LoadJob::LoadJob() : bRunning(false), bDone(false), progress(0.0f), stage("")
+{
+}
+
+LoadJob::~LoadJob()
+{
+	if (worker.joinable())
+		worker.join();
+}
+
+bool LoadJob::Start(const std::string& path)
+{
+	if (bRunning)
+		return false;
+	if (worker.joinable())
+		worker.join();
+	result = loadResult();
+	bDone = false;
+	stage = "Opening";
+	progress = 0.0f;
+	bRunning = true;
+	worker = std::thread(&LoadJob::Run, this, path);
+	return true;
+}
+
+bool LoadJob::IsRunning() const
+{
+	return bRunning;
+}
+
+bool LoadJob::IsDone() const
+{
+	return bDone;
+}
+
+float LoadJob::Progress() const
+{
+	return progress;
+}
+
+const char* LoadJob::Stage() const
+{
+	return stage;
+}
+
+loadResult LoadJob::Finish()
+{
+	if (worker.joinable())
+		worker.join();
+	bRunning = false;
+	bDone = false;
+	return std::move(result);
+}
+
+void LoadJob::Run(std::string path)
+{
+	result.reader = BinaryReader(path);
+	result.bOpened = result.reader.bIsOpened;
+	if (result.bOpened)
+	{
+		stage = "Reading object table";
+		result.status = ParseTmdTable(result.reader, result.tmd, result.errors, [this](int done, int total)
+		{
+			progress = total > 0 ? (float)done / total : 1.0f;
+		});
+	}
+	stage = "Done";
+	progress = 1.0f;
+	bDone = true; //publishes result- UI thread doesn't look at it before this
+}
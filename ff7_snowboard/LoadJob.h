@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BinaryReader.h"
+#include "Tmd.h"
+
+//what finished LoadJob hands over to the UI thread
+struct loadResult
+{
+	bool bOpened = false; //file could be opened and mapped
+	TmdStatus status = TMD_OK;
+	std::vector<tmdError> errors;
+	BinaryReader reader;
+	Tmd tmd; //object table only, bodies are left for ObjectCache
+};
+
+//Opens and maps a TMD and reads its object table on a worker thread, so render loop keeps going while
+//a big archive comes from a slow disk. Worker only fills its own loadResult- the UI thread polls IsDone()
+//and swaps the result in with Finish() on the next frame, so br and currentTmd are never shared
+class LoadJob
+{
+public:
+	LoadJob();
+	~LoadJob(); //waits for running load
+	//false if a load is already running
+	bool Start(const std::string& path);
+	//started and not yet taken with Finish
+	bool IsRunning() const;
+	bool IsDone() const;
+	float Progress() const; //0-1
+	const char* Stage() const;
+	//waits for worker and moves result out
+	loadResult Finish();
+
+private:
+	void Run(std::string path);
+	std::thread worker;
+	std::atomic<bool> bRunning;
+	std::atomic<bool> bDone;
+	std::atomic<float> progress;
+	std::atomic<const char*> stage;
+	loadResult result;
+};
@@ -0,0 +1,725 @@
+#include "MeshLoader.h"
+#include "BinaryReader.h"
+#include "ParallelFor.h"
+#include "assimp/fast_atof.h"
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+
+//OBJ is cut into chunks of at least this size, a few per core so uneven chunks even out
+static const int OBJ_MIN_CHUNK = 1024 * 1024;
+static const int OBJ_CHUNKS_PER_THREAD = 4;
+//vertices and triangles are handed to threads in blocks of this many
+static const int LOADER_BLOCK = 65536;
+
+struct objChunk
+{
+	const char* begin;
+	const char* end;
+	int positions;
+	int normals;
+	int texcoords;
+	int triangles;
+	int firstPosition;
+	int firstNormal;
+	int firstTexcoord;
+	int firstTriangle;
+};
+
+//parsed OBJ data shared by all chunks, every chunk writes only its own ranges
+struct objData
+{
+	std::vector<float> positions; //XYZ
+	std::vector<float> colors; //RGB of positions with vertex color
+	std::vector<char> bHasColor;
+	std::vector<float> normals; //XYZ
+	std::vector<int> cornerPositions; //per triangle corner, -1 for none
+	std::vector<int> cornerNormals;
+	int texcoordCount = 0; //vt aren't kept, only their indices are checked
+};
+
+static bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* SkipSpaces(const char* p, const char* end)
+{
+	while (p < end && IsSpace(*p))
+		p++;
+	return p;
+}
+
+static const char* LineEnd(const char* p, const char* end)
+{
+	const char* newline = (const char*)memchr(p, '\n', end - p);
+	return newline != nullptr ? newline : end;
+}
+
+static bool IsNumberStart(char c)
+{
+	return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+}
+
+static bool ParseIndex(const char*& p, const char* end, int& value)
+{
+	bool bNegative = p < end && *p == '-';
+	if (bNegative)
+		p++;
+	if (p >= end || *p < '0' || *p > '9')
+		return false;
+	long long result = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		result = result * 10 + (*p - '0');
+		if (result > INT_MAX)
+			return false;
+		p++;
+	}
+	value = bNegative ? -(int)result : (int)result;
+	return true;
+}
+
+//0- other line, 1- v, 2- vn, 3- f, 4- vt. p is moved behind the keyword
+static int ObjLineKind(const char*& p, const char* end)
+{
+	if (end - p >= 2 && p[0] == 'v' && IsSpace(p[1]))
+	{
+		p += 2;
+		return 1;
+	}
+	if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2]))
+	{
+		p += 3;
+		return 2;
+	}
+	if (end - p >= 2 && p[0] == 'f' && IsSpace(p[1]))
+	{
+		p += 2;
+		return 3;
+	}
+	if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && IsSpace(p[2]))
+	{
+		p += 3;
+		return 4;
+	}
+	return 0;
+}
+
+static int CountTokens(const char* p, const char* end)
+{
+	int tokens = 0;
+	while (true)
+	{
+		p = SkipSpaces(p, end);
+		if (p >= end)
+			return tokens;
+		tokens++;
+		while (p < end && !IsSpace(*p))
+			p++;
+	}
+}
+
+static objChunk MakeChunk(const char* begin, const char* end)
+{
+	objChunk chunk = objChunk();
+	chunk.begin = begin;
+	chunk.end = end;
+	return chunk;
+}
+
+static void CountObjChunk(objChunk& chunk)
+{
+	chunk.positions = chunk.normals = chunk.texcoords = chunk.triangles = 0;
+	for (const char* line = chunk.begin; line < chunk.end;)
+	{
+		const char* end = LineEnd(line, chunk.end);
+		const char* p = SkipSpaces(line, end);
+		switch (ObjLineKind(p, end))
+		{
+		case 1:
+			chunk.positions++;
+			break;
+		case 2:
+			chunk.normals++;
+			break;
+		case 3:
+			chunk.triangles += std::max(CountTokens(p, end) - 2, 0);
+			break;
+		case 4:
+			chunk.texcoords++;
+			break;
+		}
+		line = end + 1;
+	}
+}
+
+//fast_atoreal_move stops on first character that isn't part of a number, every line handed here ends
+//with '\n' so it never reads past the chunk. Throws std::invalid_argument on garbage
+static bool ParseObjChunk(const objChunk& chunk, objData& data)
+{
+	int position = chunk.firstPosition;
+	int normal = chunk.firstNormal;
+	int texcoord = chunk.firstTexcoord;
+	int corner = chunk.firstTriangle * 3;
+	//corners of current face- nothing is written to data before the face is known to be a polygon,
+	//CountObjChunk reserved no room for points and lines and the room after belongs to the next chunk
+	std::vector<int> facePositions, faceNormals;
+	for (const char* line = chunk.begin; line < chunk.end;)
+	{
+		const char* end = LineEnd(line, chunk.end);
+		const char* p = SkipSpaces(line, end);
+		int kind = ObjLineKind(p, end);
+		if (kind == 1 || kind == 2)
+		{
+			float values[6];
+			int count = 0;
+			for (p = SkipSpaces(p, end); count < 6 && p < end && IsNumberStart(*p); p = SkipSpaces(p, end))
+				p = Assimp::fast_atoreal_move<float>(p, values[count++]);
+			if (count < 3)
+				return false;
+			float* xyz = kind == 1 ? &data.positions[position * 3] : &data.normals[normal * 3];
+			memcpy(xyz, values, 3 * sizeof(float));
+			if (kind == 1)
+			{
+				data.bHasColor[position] = count == 6; //x y z r g b, 4 numbers are x y z w
+				if (count == 6)
+					memcpy(&data.colors[position * 3], values + 3, 3 * sizeof(float));
+				position++;
+			}
+			else
+				normal++;
+		}
+		else if (kind == 3)
+		{
+			//v, v/vt, v//vn or v/vt/vn. Negative indices count back from the last one read so far, 0 is invalid
+			facePositions.clear();
+			faceNormals.clear();
+			for (p = SkipSpaces(p, end); p < end; p = SkipSpaces(p, end))
+			{
+				int v = 0, vn = 0, vt = 0;
+				if (!ParseIndex(p, end, v) || v == 0)
+					return false;
+				if (p < end && *p == '/')
+				{
+					p++;
+					if (p < end && *p != '/' && (!ParseIndex(p, end, vt) || vt == 0))
+						return false;
+					if (p < end && *p == '/')
+					{
+						p++;
+						if (!ParseIndex(p, end, vn) || vn == 0)
+							return false;
+					}
+				}
+				if (p < end && !IsSpace(*p))
+					return false;
+				//positive ones past the end are caught once all chunks are read
+				if (position + v < 0 || normal + vn < 0 || texcoord + vt < 0 || vt > data.texcoordCount)
+					return false;
+				facePositions.push_back(v > 0 ? v - 1 : position + v);
+				faceNormals.push_back(vn > 0 ? vn - 1 : vn < 0 ? normal + vn : -1);
+			}
+			//fan- first corner, previous corner, this one. Points and lines are skipped
+			for (size_t i = 2; i < facePositions.size(); i++)
+			{
+				size_t fan[3] = { 0, i - 1, i };
+				for (size_t k : fan)
+				{
+					data.cornerPositions[corner] = facePositions[k];
+					data.cornerNormals[corner] = faceNormals[k];
+					corner++;
+				}
+			}
+		}
+		else if (kind == 4)
+			texcoord++;
+		line = end + 1;
+	}
+	return true;
+}
+
+bool LoadObj(const BinaryReader& file, std::vector<float>& corners)
+{
+	const char* text = (const char*)file.GetSpan(0, file.size());
+	if (text == nullptr || file.size() == 0)
+		return false;
+	const char* textEnd = text + file.size();
+
+	//last line without '\n' is parsed from a copy so number parsing can't run off the mapping
+	std::string tail;
+	const char* lastNewline = textEnd;
+	while (lastNewline > text && lastNewline[-1] != '\n')
+		lastNewline--;
+	if (lastNewline != textEnd)
+	{
+		tail.assign(lastNewline, textEnd);
+		tail.push_back('\n');
+		textEnd = lastNewline;
+	}
+
+	//1. cut into chunks on line boundaries
+	int threads = std::max((int)std::thread::hardware_concurrency(), 1);
+	long long size = textEnd - text;
+	int chunkCount = (int)std::max(std::min(size / OBJ_MIN_CHUNK, (long long)threads * OBJ_CHUNKS_PER_THREAD), 1LL);
+	std::vector<objChunk> chunks;
+	const char* begin = text;
+	for (int i = 0; i < chunkCount && begin < textEnd; i++)
+	{
+		const char* end = i == chunkCount - 1 ? textEnd : std::max(begin, text + size * (i + 1) / chunkCount);
+		end = end < textEnd ? LineEnd(end, textEnd) + 1 : textEnd;
+		end = std::min(end, textEnd);
+		chunks.push_back(MakeChunk(begin, end));
+		begin = end;
+	}
+	if (!tail.empty())
+		chunks.push_back(MakeChunk(tail.data(), tail.data() + tail.size()));
+
+	//2. count records per chunk so every chunk knows where its vertices and triangles go
+	ParallelFor((int)chunks.size(), [&](int i)
+	{
+		CountObjChunk(chunks[i]);
+	});
+	long long positions = 0, normals = 0, texcoords = 0, triangles = 0;
+	for (objChunk& chunk : chunks)
+	{
+		chunk.firstPosition = (int)positions;
+		chunk.firstNormal = (int)normals;
+		chunk.firstTexcoord = (int)texcoords;
+		chunk.firstTriangle = (int)triangles;
+		positions += chunk.positions;
+		normals += chunk.normals;
+		texcoords += chunk.texcoords;
+		triangles += chunk.triangles;
+	}
+	if (triangles * 3 * 6 > INT_MAX || positions * 3 > INT_MAX || normals * 3 > INT_MAX || texcoords > INT_MAX)
+		return false;
+
+	//3. parse
+	objData data;
+	data.positions.resize(positions * 3);
+	data.colors.resize(positions * 3);
+	data.bHasColor.resize(positions);
+	data.normals.resize(normals * 3);
+	data.cornerPositions.resize(triangles * 3);
+	data.cornerNormals.resize(triangles * 3);
+	data.texcoordCount = (int)texcoords;
+	std::vector<int> cornerCounts(chunks.size());
+	std::atomic<bool> bFailed(false);
+	ParallelFor((int)chunks.size(), [&](int i)
+	{
+		try
+		{
+			if (!ParseObjChunk(chunks[i], data))
+				bFailed = true;
+		}
+		catch (const std::exception&)
+		{
+			bFailed = true;
+		}
+	});
+	if (bFailed)
+		return false;
+
+	//4. resolve corners
+	corners.resize(triangles * 3 * 6);
+	int cornerCount = (int)triangles * 3;
+	ParallelFor((cornerCount + LOADER_BLOCK - 1) / LOADER_BLOCK, [&](int block)
+	{
+		int last = std::min((block + 1) * LOADER_BLOCK, cornerCount);
+		for (int i = block * LOADER_BLOCK; i < last; i++)
+		{
+			int position = data.cornerPositions[i];
+			int normal = data.cornerNormals[i];
+			if (position < 0 || position >= positions || normal >= normals)
+			{
+				bFailed = true;
+				return;
+			}
+			float* out = &corners[i * 6];
+			out[0] = data.positions[position * 3] / 100.0f;
+			out[1] = data.positions[position * 3 + 1] / 100.0f;
+			out[2] = data.positions[position * 3 + 2] / 100.0f;
+			if (data.bHasColor[position])
+				memcpy(out + 3, &data.colors[position * 3], 3 * sizeof(float));
+			else if (normal >= 0)
+				memcpy(out + 3, &data.normals[normal * 3], 3 * sizeof(float));
+			else
+				out[3] = out[4] = out[5] = 0.0f;
+		}
+	});
+	return !bFailed;
+}
+
+//property types resolved from header names once, so value reads switch on them instead of comparing strings
+enum PlyType
+{
+	PLY_UNKNOWN,
+	PLY_INT8,
+	PLY_UINT8,
+	PLY_INT16,
+	PLY_UINT16,
+	PLY_INT32,
+	PLY_UINT32,
+	PLY_FLOAT32,
+	PLY_FLOAT64
+};
+
+struct plyProperty
+{
+	std::string name;
+	PlyType type;
+	bool bList;
+	PlyType countType; //of list length
+};
+
+struct plyElement
+{
+	std::string name;
+	int count;
+	std::vector<plyProperty> properties;
+};
+
+static PlyType ParsePlyType(const std::string& name)
+{
+	if (name == "char" || name == "int8")
+		return PLY_INT8;
+	if (name == "uchar" || name == "uint8")
+		return PLY_UINT8;
+	if (name == "short" || name == "int16")
+		return PLY_INT16;
+	if (name == "ushort" || name == "uint16")
+		return PLY_UINT16;
+	if (name == "int" || name == "int32")
+		return PLY_INT32;
+	if (name == "uint" || name == "uint32")
+		return PLY_UINT32;
+	if (name == "float" || name == "float32")
+		return PLY_FLOAT32;
+	if (name == "double" || name == "float64")
+		return PLY_FLOAT64;
+	return PLY_UNKNOWN;
+}
+
+static int PlyTypeSize(PlyType type)
+{
+	switch (type)
+	{
+	case PLY_INT8:
+	case PLY_UINT8:
+		return 1;
+	case PLY_INT16:
+	case PLY_UINT16:
+		return 2;
+	case PLY_INT32:
+	case PLY_UINT32:
+	case PLY_FLOAT32:
+		return 4;
+	case PLY_FLOAT64:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+static double ReadPlyValue(const unsigned char* p, PlyType type)
+{
+	switch (type)
+	{
+	case PLY_INT8:
+		return (signed char)p[0];
+	case PLY_UINT8:
+		return p[0];
+	case PLY_INT16:
+	{
+		short value;
+		memcpy(&value, p, 2);
+		return value;
+	}
+	case PLY_UINT16:
+	{
+		unsigned short value;
+		memcpy(&value, p, 2);
+		return value;
+	}
+	case PLY_INT32:
+	{
+		int value;
+		memcpy(&value, p, 4);
+		return value;
+	}
+	case PLY_UINT32:
+	{
+		unsigned int value;
+		memcpy(&value, p, 4);
+		return value;
+	}
+	case PLY_FLOAT32:
+	{
+		float value;
+		memcpy(&value, p, 4);
+		return value;
+	}
+	default:
+	{
+		double value;
+		memcpy(&value, p, 8);
+		return value;
+	}
+	}
+}
+
+//byte size of element with fixed size properties, 0 if it has lists or unknown types
+static int PlyStride(const plyElement& element)
+{
+	int stride = 0;
+	for (const plyProperty& property : element.properties)
+	{
+		int size = PlyTypeSize(property.type);
+		if (property.bList || size == 0)
+			return 0;
+		stride += size;
+	}
+	return stride;
+}
+
+//offset of property in fixed size element, -1 if there's none
+static int PlyOffset(const plyElement& element, const char* name, PlyType& type)
+{
+	int offset = 0;
+	for (const plyProperty& property : element.properties)
+	{
+		if (property.name == name)
+		{
+			type = property.type;
+			return offset;
+		}
+		offset += PlyTypeSize(property.type);
+	}
+	return -1;
+}
+
+bool LoadPly(const BinaryReader& file, std::vector<float>& corners)
+{
+	const char* text = (const char*)file.GetSpan(0, file.size());
+	if (text == nullptr)
+		return false;
+	static const char HEADER_END[] = "end_header";
+	const char* headerEnd = std::search(text, text + file.size(), HEADER_END, HEADER_END + sizeof(HEADER_END) - 1);
+	if (headerEnd == text + file.size())
+		return false;
+	const char* body = LineEnd(headerEnd, text + file.size()) + 1;
+
+	std::istringstream header(std::string(text, headerEnd));
+	std::string line;
+	std::vector<plyElement> elements;
+	bool bBinaryLittleEndian = false;
+	while (std::getline(header, line))
+	{
+		std::istringstream tokens(line);
+		std::string keyword;
+		tokens >> keyword;
+		if (keyword == "format")
+		{
+			std::string format;
+			tokens >> format;
+			bBinaryLittleEndian = format == "binary_little_endian";
+		}
+		else if (keyword == "element")
+		{
+			plyElement element;
+			if (!(tokens >> element.name >> element.count) || element.count < 0)
+				return false;
+			elements.push_back(element);
+		}
+		else if (keyword == "property" && !elements.empty())
+		{
+			plyProperty property;
+			std::string type, countType;
+			tokens >> type;
+			property.bList = type == "list";
+			if (property.bList)
+				tokens >> countType >> type;
+			tokens >> property.name;
+			property.type = ParsePlyType(type);
+			property.countType = ParsePlyType(countType);
+			elements.back().properties.push_back(property);
+		}
+	}
+	if (!bBinaryLittleEndian)
+		return false; //ASCII and big-endian are left to Assimp
+
+	const unsigned char* p = (const unsigned char*)body;
+	const unsigned char* end = (const unsigned char*)text + file.size();
+	std::vector<float> positions;
+	std::vector<float> colors;
+	bool bColors = false;
+	for (const plyElement& element : elements)
+	{
+		if (element.name == "vertex")
+		{
+			int stride = PlyStride(element);
+			PlyType typeX = PLY_UNKNOWN, typeY = PLY_UNKNOWN, typeZ = PLY_UNKNOWN, typeR = PLY_UNKNOWN, typeG = PLY_UNKNOWN, typeB = PLY_UNKNOWN;
+			int x = PlyOffset(element, "x", typeX);
+			int y = PlyOffset(element, "y", typeY);
+			int z = PlyOffset(element, "z", typeZ);
+			int r = PlyOffset(element, "red", typeR);
+			int g = PlyOffset(element, "green", typeG);
+			int b = PlyOffset(element, "blue", typeB);
+			bColors = r != -1 && g != -1 && b != -1;
+			if (!bColors)
+			{
+				//no vertex colors- normals become colors like with Assimp import
+				r = PlyOffset(element, "nx", typeR);
+				g = PlyOffset(element, "ny", typeG);
+				b = PlyOffset(element, "nz", typeB);
+			}
+			bool bHasRGB = r != -1 && g != -1 && b != -1;
+			if (stride == 0 || x == -1 || y == -1 || z == -1 || (long long)stride * element.count > end - p)
+				return false;
+			//uchar colors are 0-255, float ones 0-1
+			float colorScale = bColors && PlyTypeSize(typeR) == 1 ? 1.0f / 255.0f : 1.0f;
+			positions.resize((size_t)element.count * 3);
+			colors.assign((size_t)element.count * 3, 0.0f);
+			const unsigned char* vertices = p;
+			ParallelFor((element.count + LOADER_BLOCK - 1) / LOADER_BLOCK, [&](int block)
+			{
+				int last = std::min((block + 1) * LOADER_BLOCK, element.count);
+				for (int i = block * LOADER_BLOCK; i < last; i++)
+				{
+					const unsigned char* vertex = vertices + (size_t)i * stride;
+					positions[i * 3] = (float)ReadPlyValue(vertex + x, typeX) / 100.0f;
+					positions[i * 3 + 1] = (float)ReadPlyValue(vertex + y, typeY) / 100.0f;
+					positions[i * 3 + 2] = (float)ReadPlyValue(vertex + z, typeZ) / 100.0f;
+					if (bHasRGB)
+					{
+						colors[i * 3] = (float)ReadPlyValue(vertex + r, typeR) * colorScale;
+						colors[i * 3 + 1] = (float)ReadPlyValue(vertex + g, typeG) * colorScale;
+						colors[i * 3 + 2] = (float)ReadPlyValue(vertex + b, typeB) * colorScale;
+					}
+				}
+			});
+			p += (size_t)stride * element.count;
+		}
+		else if (element.name == "face")
+		{
+			//faces differ in size, so they are walked in order
+			int vertexCount = (int)positions.size() / 3;
+			corners.clear();
+			corners.reserve((size_t)element.count * 18);
+			std::vector<int> indices;
+			for (int face = 0; face < element.count; face++)
+			{
+				for (const plyProperty& property : element.properties)
+				{
+					int size = PlyTypeSize(property.type);
+					if (size == 0)
+						return false;
+					if (!property.bList)
+					{
+						p += size;
+						continue;
+					}
+					int countSize = PlyTypeSize(property.countType);
+					if (countSize == 0 || end - p < countSize)
+						return false;
+					int count = (int)ReadPlyValue(p, property.countType);
+					p += countSize;
+					if (count < 0 || (long long)count * size > end - p)
+						return false;
+					bool bIndices = property.name == "vertex_indices" || property.name == "vertex_index";
+					if (bIndices)
+					{
+						indices.resize(count);
+						for (int k = 0; k < count; k++)
+						{
+							indices[k] = (int)ReadPlyValue(p + k * size, property.type);
+							if (indices[k] < 0 || indices[k] >= vertexCount)
+								return false;
+						}
+						for (int k = 2; k < count; k++)
+						{
+							int fan[3] = { indices[0], indices[k - 1], indices[k] };
+							for (int vertex : fan)
+							{
+								corners.insert(corners.end(), &positions[vertex * 3], &positions[vertex * 3] + 3);
+								corners.insert(corners.end(), &colors[vertex * 3], &colors[vertex * 3] + 3);
+							}
+						}
+					}
+					p += (size_t)count * size;
+				}
+				if (p > end)
+					return false;
+			}
+			return true;
+		}
+		else
+		{
+			//anything before faces has to be skipped, only fixed size elements can be
+			int stride = PlyStride(element);
+			if (stride == 0 || (long long)stride * element.count > end - p)
+				return false;
+			p += (size_t)stride * element.count;
+		}
+	}
+	return false; //no faces
+}
+
+bool LoadStl(const BinaryReader& file, std::vector<float>& corners)
+{
+	//80 byte header, triangle count, then 50 bytes per triangle- ASCII STL never matches the size
+	const unsigned char* header = file.GetSpan(80, 4);
+	if (header == nullptr)
+		return false;
+	unsigned int triangleCount = header[0] | (header[1] << 8) | (header[2] << 16) | ((unsigned int)header[3] << 24);
+	if (triangleCount > (unsigned int)(INT_MAX / 18) || 84 + (long long)triangleCount * 50 != file.size())
+		return false;
+	const unsigned char* triangles = file.GetSpan(84, (int)triangleCount * 50);
+	if (triangles == nullptr && triangleCount != 0)
+		return false;
+	corners.resize((size_t)triangleCount * 18);
+	int count = (int)triangleCount;
+	ParallelFor((count + LOADER_BLOCK - 1) / LOADER_BLOCK, [&](int block)
+	{
+		int last = std::min((block + 1) * LOADER_BLOCK, count);
+		for (int i = block * LOADER_BLOCK; i < last; i++)
+		{
+			//facet normal, then three XYZ corners, then 2 byte attribute
+			float values[12];
+			memcpy(values, triangles + (size_t)i * 50, sizeof(values));
+			float* out = &corners[(size_t)i * 18];
+			for (int k = 0; k < 3; k++)
+			{
+				out[k * 6] = values[3 + k * 3] / 100.0f;
+				out[k * 6 + 1] = values[4 + k * 3] / 100.0f;
+				out[k * 6 + 2] = values[5 + k * 3] / 100.0f;
+				memcpy(out + k * 6 + 3, values, 3 * sizeof(float));
+			}
+		}
+	});
+	return true;
+}
+
+bool LoadMeshFile(const std::string& path, std::vector<float>& corners)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+	if (extension != "obj" && extension != "ply" && extension != "stl")
+		return false;
+	BinaryReader file(path);
+	if (!file.bIsOpened)
+		return false;
+	if (extension == "obj")
+		return LoadObj(file, corners);
+	if (extension == "ply")
+		return LoadPly(file, corners);
+	return LoadStl(file, corners);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+
+class BinaryReader;
+
+//Loaders of common mesh formats straight into de-indexed XYZRGB corners (6 floats each, 3 per polygon)
+//like vertices[] in main.cpp, without going through Assimp. Positions are divided by 100 like Assimp
+//imports are, corner color is vertex color when file has it, otherwise vertex normal (facet normal for STL).
+//Polygons are triangulated as fans. They return false when file isn't in a form they read- the caller
+//falls back to Assimp then
+
+//Wavefront OBJ- file is cut into chunks parsed on all CPU cores. Materials aren't read
+bool LoadObj(const BinaryReader& file, std::vector<float>& corners);
+
+//binary little-endian PLY
+bool LoadPly(const BinaryReader& file, std::vector<float>& corners);
+
+//binary STL
+bool LoadStl(const BinaryReader& file, std::vector<float>& corners);
+
+//maps path and picks loader by its extension
+bool LoadMeshFile(const std::string& path, std::vector<float>& corners);
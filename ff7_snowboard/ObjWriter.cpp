@@ -0,0 +1,247 @@
+#include "ObjWriter.h"
+#include <cmath>
+#include <cstring>
+
+static const size_t OBJ_BUFFER_SIZE = 1024 * 1024;
+
+static double Pow10(int exponent)
+{
+	//exact powers for the range positions and colors live in, std::pow for the rest
+	static const double table[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	if (exponent >= 0 && exponent <= 22)
+		return table[exponent];
+	return std::pow(10.0, exponent);
+}
+
+static char* FormatUInt(char* p, unsigned long long value)
+{
+	char digits[24];
+	int count = 0;
+	do
+	{
+		digits[count++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+	while (count > 0)
+		*p++ = digits[--count];
+	return p;
+}
+
+char* FormatFloat(char* p, float value)
+{
+	if (value != value || value == 0.0f)
+	{
+		*p++ = '0'; //OBJ has no NaN, negative zero is written as plain zero
+		return p;
+	}
+	if (value < 0.0f)
+	{
+		*p++ = '-';
+		value = -value;
+	}
+	if (value == INFINITY)
+	{
+		memcpy(p, "1e39", 4); //reads back as infinity
+		return p + 4;
+	}
+	double d = value;
+	//integers are by far the most common in TMD data (raw int16 units)
+	if (d < 1e15 && d == std::floor(d))
+		return FormatUInt(p, (unsigned long long)d);
+
+	int exponent = (int)std::floor(std::log10(d));
+	if (Pow10(exponent) > d)
+		exponent--;
+	else if (Pow10(exponent + 1) <= d)
+		exponent++;
+	//find the smallest number of significant digits that parses back to the same float. 9 always does
+	unsigned long long digits = 0;
+	int precision;
+	for (precision = 1; precision <= 9; precision++)
+	{
+		int shift = precision - 1 - exponent;
+		double scaled = shift >= 0 ? d * Pow10(shift) : d / Pow10(-shift);
+		digits = (unsigned long long)std::llround(scaled);
+		double back = shift >= 0 ? digits / Pow10(shift) : digits * Pow10(-shift);
+		if ((float)back == value)
+			break;
+	}
+	if (precision > 9)
+		precision = 9;
+	if (digits >= (unsigned long long)Pow10(precision)) //rounding carried into next decade, e.g. 9.99 -> 10.0
+	{
+		digits /= 10;
+		exponent++;
+	}
+	while (precision > 1 && digits % 10 == 0)
+	{
+		digits /= 10;
+		precision--;
+	}
+
+	char text[16];
+	char* end = FormatUInt(text, digits);
+	int count = (int)(end - text);
+	if (exponent >= 0 && exponent < 15)
+	{
+		if (exponent >= count - 1)
+		{
+			memcpy(p, text, count);
+			p += count;
+			for (int i = count - 1; i < exponent; i++)
+				*p++ = '0';
+		}
+		else
+		{
+			memcpy(p, text, exponent + 1);
+			p += exponent + 1;
+			*p++ = '.';
+			memcpy(p, text + exponent + 1, count - exponent - 1);
+			p += count - exponent - 1;
+		}
+	}
+	else if (exponent < 0 && exponent >= -5)
+	{
+		*p++ = '0';
+		*p++ = '.';
+		for (int i = -1; i > exponent; i--)
+			*p++ = '0';
+		memcpy(p, text, count);
+		p += count;
+	}
+	else
+	{
+		*p++ = text[0];
+		if (count > 1)
+		{
+			*p++ = '.';
+			memcpy(p, text + 1, count - 1);
+			p += count - 1;
+		}
+		*p++ = 'e';
+		if (exponent < 0)
+		{
+			*p++ = '-';
+			exponent = -exponent;
+		}
+		p = FormatUInt(p, exponent);
+	}
+	return p;
+}
+
+static char* FormatInt(char* p, int value)
+{
+	if (value < 0)
+	{
+		*p++ = '-';
+		return FormatUInt(p, (unsigned long long)(-(long long)value));
+	}
+	return FormatUInt(p, value);
+}
+
+ObjWriter::ObjWriter(const std::string& path)
+{
+#ifdef _MSC_VER
+	if (fopen_s(&fd, path.c_str(), "wb") != 0)
+		fd = NULL;
+#else
+	fd = fopen(path.c_str(), "wb");
+#endif
+	if (fd != NULL)
+		buffer.resize(OBJ_BUFFER_SIZE);
+}
+
+ObjWriter::~ObjWriter()
+{
+	Close();
+}
+
+bool ObjWriter::IsOpen()
+{
+	return fd != NULL;
+}
+
+void ObjWriter::Flush()
+{
+	if (used > 0 && fwrite(buffer.data(), 1, used, fd) != used)
+		bFailed = true;
+	used = 0;
+}
+
+char* ObjWriter::Reserve(int count)
+{
+	if (used + count > buffer.size())
+		Flush();
+	return buffer.data() + used;
+}
+
+void ObjWriter::WriteVertex(float x, float y, float z)
+{
+	char* start = Reserve(64);
+	char* p = start;
+	*p++ = 'v';
+	*p++ = ' ';
+	p = FormatFloat(p, x);
+	*p++ = ' ';
+	p = FormatFloat(p, y);
+	*p++ = ' ';
+	p = FormatFloat(p, z);
+	*p++ = '\n';
+	used += p - start;
+}
+
+int ObjWriter::WriteColor(float r, float g, float b)
+{
+	colorKey key;
+	memcpy(&key.r, &r, sizeof(float));
+	memcpy(&key.g, &g, sizeof(float));
+	memcpy(&key.b, &b, sizeof(float));
+	auto found = colors.find(key);
+	if (found != colors.end())
+		return found->second;
+	int index = (int)colors.size() + 1;
+	colors.emplace(key, index);
+
+	char* start = Reserve(64);
+	char* p = start;
+	*p++ = 'v';
+	*p++ = 'n';
+	*p++ = ' ';
+	p = FormatFloat(p, r);
+	*p++ = ' ';
+	p = FormatFloat(p, g);
+	*p++ = ' ';
+	p = FormatFloat(p, b);
+	*p++ = '\n';
+	used += p - start;
+	return index;
+}
+
+void ObjWriter::WriteFace(int a, int na, int b, int nb, int c, int nc)
+{
+	char* start = Reserve(96);
+	char* p = start;
+	int corners[6] = { a, na, b, nb, c, nc };
+	*p++ = 'f';
+	for (int i = 0; i < 6; i += 2)
+	{
+		*p++ = ' ';
+		p = FormatInt(p, corners[i]);
+		*p++ = '/';
+		*p++ = '/';
+		p = FormatInt(p, corners[i + 1]);
+	}
+	*p++ = '\n';
+	used += p - start;
+}
+
+bool ObjWriter::Close()
+{
+	if (fd == NULL)
+		return false;
+	Flush();
+	if (fclose(fd) != 0)
+		bFailed = true;
+	fd = NULL;
+	return !bFailed;
+}
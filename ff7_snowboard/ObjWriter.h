@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+//Streaming Wavefront OBJ writer. Lines are formatted straight into one big buffer that is flushed
+//with a single fwrite when full. Floats are printed as the shortest text that reads back to the
+//same float, independent of C locale. Colors go into vn entries and each distinct color is written once
+class ObjWriter
+{
+public:
+	ObjWriter(const std::string& path);
+	~ObjWriter();
+	bool IsOpen();
+	void WriteVertex(float x, float y, float z);
+	//returns 1-based vn index of given color, writing the vn line only the first time it's seen
+	int WriteColor(float r, float g, float b);
+	//1-based v and vn indices of polygon corners
+	void WriteFace(int a, int na, int b, int nb, int c, int nc);
+	//flushes and closes the file, returns false if anything failed to write
+	bool Close();
+
+private:
+	struct colorKey
+	{
+		unsigned int r, g, b;
+		bool operator==(const colorKey& other) const { return r == other.r && g == other.g && b == other.b; }
+	};
+	struct colorKeyHash
+	{
+		size_t operator()(const colorKey& key) const { return key.r * 73856093u ^ key.g * 19349663u ^ key.b * 83492791u; }
+	};
+	char* Reserve(int count);
+	void Flush();
+	FILE* fd = NULL;
+	bool bFailed = false;
+	std::vector<char> buffer;
+	size_t used = 0;
+	std::unordered_map<colorKey, int, colorKeyHash> colors;
+};
+
+//writes shortest round-trip decimal form of value into p and returns pointer past last char.
+//Needs at most 16 chars
+char* FormatFloat(char* p, float value);
@@ -0,0 +1,80 @@
+#include "ObjectCache.h"
+#include "BinaryReader.h"
+
+static size_t BodyBytes(const tmdObject& object)
+{
+	return object.vertices.capacity() * sizeof(vertex) + object.polygon.capacity() * sizeof(TMD_3_NS_GP);
+}
+
+ObjectCache::ObjectCache(size_t budgetBytes) : budget(budgetBytes)
+{
+}
+
+void ObjectCache::Reset(int objectCount)
+{
+	order.clear();
+	entries.assign(objectCount, order.end());
+	sizes.assign(objectCount, 0);
+	used = 0;
+}
+
+bool ObjectCache::Acquire(Tmd& tmd, const BinaryReader& br, int i, std::vector<tmdError>& errors)
+{
+	errors.clear();
+	if (i < 0 || i >= (int)entries.size() || i >= tmd.objectCount)
+		return false;
+	tmdObject& object = tmd.objects[i];
+	bool bOk = true;
+	if (entries[i] != order.end())
+		order.splice(order.begin(), order, entries[i]);
+	else
+	{
+		bOk = DecodeObject(br, object);
+		if (!bOk)
+			AppendObjectErrors(i, object, errors);
+		order.push_front(i);
+		entries[i] = order.begin();
+		sizes[i] = BodyBytes(object);
+		used += sizes[i];
+	}
+	Trim(tmd);
+	return bOk;
+}
+
+void ObjectCache::SetBudget(Tmd& tmd, size_t budgetBytes)
+{
+	budget = budgetBytes;
+	Trim(tmd);
+}
+
+size_t ObjectCache::GetBudget() const
+{
+	return budget;
+}
+
+size_t ObjectCache::UsedBytes() const
+{
+	return used;
+}
+
+int ObjectCache::DecodedCount() const
+{
+	return (int)order.size();
+}
+
+void ObjectCache::Trim(Tmd& tmd)
+{
+	while (used > budget && order.size() > 1)
+	{
+		int i = order.back();
+		order.pop_back();
+		entries[i] = order.end();
+		used -= sizes[i];
+		sizes[i] = 0;
+		tmdObject& object = tmd.objects[i];
+		std::vector<vertex>().swap(object.vertices);
+		std::vector<TMD_3_NS_GP>().swap(object.polygon);
+		object.primBlockSize = 0;
+		object.bDecoded = false;
+	}
+}
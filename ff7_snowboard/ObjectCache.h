@@ -0,0 +1,33 @@
+#pragma once
+#include <list>
+#include <vector>
+#include <cstddef>
+#include "Tmd.h"
+
+class BinaryReader;
+
+//Decodes object bodies of a Tmd read with ParseTmdTable when they are first needed. Bodies are decoded
+//in place into tmd.objects[i]. Once decoded bodies take more than budget bytes, least recently used ones
+//are freed again- the most recently acquired object is always kept, so the one on screen stays valid
+class ObjectCache
+{
+public:
+	ObjectCache(size_t budgetBytes);
+	//forgets all objects- call whenever tmd is parsed again
+	void Reset(int objectCount);
+	//decodes object if it isn't yet and makes it most recently used. Returns false with errors
+	//filled in if its blocks are outside of file- object is kept decoded as far as it could be
+	bool Acquire(Tmd& tmd, const BinaryReader& br, int i, std::vector<tmdError>& errors);
+	void SetBudget(Tmd& tmd, size_t budgetBytes);
+	size_t GetBudget() const;
+	size_t UsedBytes() const;
+	int DecodedCount() const;
+
+private:
+	void Trim(Tmd& tmd);
+	size_t budget;
+	size_t used = 0;
+	std::list<int> order; //most recently used first
+	std::vector<std::list<int>::iterator> entries; //per object, order.end() when not decoded
+	std::vector<size_t> sizes; //bytes of every decoded body
+};
@@ -0,0 +1,30 @@
+#include "ParallelFor.h"
+#include <thread>
+#include <atomic>
+#include <vector>
+
+void ParallelFor(int count, const std::function<void(int)>& job, int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency();
+	if (threadCount > count)
+		threadCount = count;
+	if (threadCount <= 1)
+	{
+		for (int i = 0; i < count; i++)
+			job(i);
+		return;
+	}
+	std::atomic<int> next(0);
+	auto worker = [&]()
+	{
+		for (int i = next++; i < count; i = next++)
+			job(i);
+	};
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threadCount; i++)
+		workers.emplace_back(worker);
+	worker(); //calling thread works too
+	for (std::thread& thread : workers)
+		thread.join();
+}
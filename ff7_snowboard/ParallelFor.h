@@ -0,0 +1,6 @@
+#pragma once
+#include <functional>
+
+//calls job(i) for every i in [0, count) spread over up to threadCount threads (0 = all cores).
+//Indices are handed out one by one so uneven jobs still balance. Blocks until all jobs are done
+void ParallelFor(int count, const std::function<void(int)>& job, int threadCount = 0);
@@ -0,0 +1,173 @@
+#include "SceneImport.h"
+#include "ParallelFor.h"
+#include "assimp/postprocess.h"
+#include "assimp/config.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+//big meshes are cut into pieces of this many faces so one mesh still keeps every core busy
+static const unsigned int FACES_PER_JOB = 16384;
+
+const importPreset IMPORT_PRESETS[] =
+{
+	{ "Fast", aiProcess_Triangulate },
+	{ "Clean", aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FindDegenerates | aiProcess_SortByPType },
+	{ "Compact", aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FindDegenerates | aiProcess_SortByPType
+		| aiProcess_OptimizeMeshes | aiProcess_ImproveCacheLocality },
+};
+const int IMPORT_PRESET_COUNT = sizeof(IMPORT_PRESETS) / sizeof(IMPORT_PRESETS[0]);
+
+void SetupImporter(Assimp::Importer& importer)
+{
+	importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+	importer.SetPropertyBool(AI_CONFIG_PP_FD_REMOVE, true);
+}
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const aiScene* ReadScene(Assimp::Importer& importer, const std::string& path, int preset, importReport& report)
+{
+	auto start = std::chrono::steady_clock::now();
+	const aiScene* scene = importer.ReadFile(path, 0);
+	report.readMs = MillisecondsSince(start);
+	if (scene == nullptr)
+		return nullptr;
+	start = std::chrono::steady_clock::now();
+	scene = importer.ApplyPostProcessing(IMPORT_PRESETS[preset].flags);
+	report.postProcessMs = MillisecondsSince(start);
+	if (scene == nullptr)
+		return nullptr;
+	report.bUsed = true;
+	report.vertices = 0;
+	report.faces = 0;
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+	{
+		report.vertices += scene->mMeshes[i]->mNumVertices;
+		report.faces += scene->mMeshes[i]->mNumFaces;
+	}
+	return scene;
+}
+
+std::string DescribeImportReport(int preset, const importReport& report)
+{
+	char localn[256];
+	std::snprintf(localn, 256, "%s: read %.1f ms, post-process %.1f ms, %u vertices, %u faces", IMPORT_PRESETS[preset].name,
+		report.readMs, report.postProcessMs, report.vertices, report.faces);
+	return std::string(localn);
+}
+
+SceneImport::SceneImport(const aiScene* scene) : scene(scene)
+{
+	if (scene == nullptr)
+		return;
+	if (scene->mRootNode != nullptr)
+		AddNode(scene->mRootNode, aiMatrix4x4());
+	else
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+			instances.push_back({ i, aiMatrix4x4() });
+
+	colors.resize(scene->mNumMeshes);
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+	{
+		unsigned int materialIndex = scene->mMeshes[i]->mMaterialIndex;
+		colors[i].bDiffuse = materialIndex < scene->mNumMaterials
+			&& scene->mMaterials[materialIndex]->Get(AI_MATKEY_COLOR_DIFFUSE, colors[i].diffuse) == AI_SUCCESS;
+	}
+
+	for (int i = 0; i < (int)instances.size(); i++)
+	{
+		const aiMesh* mesh = scene->mMeshes[instances[i].mesh];
+		for (unsigned int face = 0; face < mesh->mNumFaces; face += FACES_PER_JOB)
+			ranges.push_back({ i, face, std::min(FACES_PER_JOB, mesh->mNumFaces - face), 0 });
+	}
+
+	//triangles are counted per range first so every range knows where its corners go
+	std::vector<int> triangles(ranges.size());
+	ParallelFor((int)ranges.size(), [&](int r)
+	{
+		const aiMesh* mesh = scene->mMeshes[instances[ranges[r].instance].mesh];
+		int count = 0;
+		for (unsigned int face = ranges[r].firstFace; face < ranges[r].firstFace + ranges[r].faceCount; face++)
+			if (mesh->mFaces[face].mNumIndices == 3)
+				count++;
+		triangles[r] = count;
+	});
+	for (size_t r = 0; r < ranges.size(); r++)
+	{
+		ranges[r].firstCorner = cornerCount;
+		cornerCount += triangles[r] * 3;
+	}
+}
+
+void SceneImport::AddNode(const aiNode* node, const aiMatrix4x4& parent)
+{
+	aiMatrix4x4 transform = parent * node->mTransformation;
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+		if (node->mMeshes[i] < scene->mNumMeshes)
+			instances.push_back({ node->mMeshes[i], transform });
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		AddNode(node->mChildren[i], transform);
+}
+
+int SceneImport::CornerCount() const
+{
+	return cornerCount;
+}
+
+bool SceneImport::HasColors() const
+{
+	for (const meshInstance& instance : instances)
+		if (!colors[instance.mesh].bDiffuse && !scene->mMeshes[instance.mesh]->HasNormals())
+			return false;
+	return true;
+}
+
+void SceneImport::Flatten(float* dst) const
+{
+	ParallelFor((int)ranges.size(), [&](int r)
+	{
+		const faceRange& range = ranges[r];
+		const meshInstance& instance = instances[range.instance];
+		const aiMesh* mesh = scene->mMeshes[instance.mesh];
+		const meshColor& color = colors[instance.mesh];
+		//normals go through inverse transpose so scaled nodes keep them perpendicular
+		aiMatrix3x3 normalTransform(instance.transform);
+		if (normalTransform.Determinant() != 0.0f)
+			normalTransform.Inverse().Transpose();
+		float* out = dst + range.firstCorner * 6;
+		for (unsigned int face = range.firstFace; face < range.firstFace + range.faceCount; face++)
+		{
+			if (mesh->mFaces[face].mNumIndices != 3) //points and lines survive triangulation
+				continue;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int index = mesh->mFaces[face].mIndices[k];
+				aiVector3D position = instance.transform * mesh->mVertices[index];
+				out[0] = position.x / 100.0f;
+				out[1] = position.y / 100.0f;
+				out[2] = position.z / 100.0f;
+				if (color.bDiffuse)
+				{
+					out[3] = color.diffuse.r;
+					out[4] = color.diffuse.g;
+					out[5] = color.diffuse.b;
+				}
+				else if (mesh->HasNormals())
+				{
+					aiVector3D normal = normalTransform * mesh->mNormals[index];
+					normal.Normalize();
+					out[3] = normal.x;
+					out[4] = normal.y;
+					out[5] = normal.z;
+				}
+				else
+					out[3] = out[4] = out[5] = 0.0f;
+				out += 6;
+			}
+		}
+	});
+}
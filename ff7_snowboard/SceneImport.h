@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "assimp/scene.h"
+#include "assimp/Importer.hpp"
+
+//post-processing sets offered on import, from fastest to most compact
+struct importPreset
+{
+	const char* name;
+	unsigned int flags; //aiPostProcessSteps
+};
+extern const importPreset IMPORT_PRESETS[];
+extern const int IMPORT_PRESET_COUNT;
+
+//what the last import with a preset cost and produced
+struct importReport
+{
+	bool bUsed = false;
+	double readMs = 0.0; //parsing the file
+	double postProcessMs = 0.0;
+	unsigned int vertices = 0; //in all meshes after post-processing
+	unsigned int faces = 0;
+};
+
+//sets importer up for presets- points and lines are dropped by SortByPType, degenerates are removed.
+//Call once on importer that is kept for the session
+void SetupImporter(Assimp::Importer& importer);
+
+//reads path and applies preset as a separate step so both are timed. Returns NULL on failure
+const aiScene* ReadScene(Assimp::Importer& importer, const std::string& path, int preset, importReport& report);
+
+//one line of importReport for the GUI
+std::string DescribeImportReport(int preset, const importReport& report);
+
+//Flattens every triangle of every mesh in scene into de-indexed XYZRGB corners (6 floats each, 3 per
+//polygon) in the layout of vertices[] in main.cpp. Meshes are placed by transforms of all nodes up to the
+//root, positions are divided by 100 like the tool always imported them. Corner color is diffuse color of
+//mesh material, or vertex normal if material has none. Meshes are converted on all CPU cores.
+//Points and lines are skipped
+class SceneImport
+{
+public:
+	SceneImport(const aiScene* scene);
+	int CornerCount() const;
+	//writes CornerCount() corners to dst
+	void Flatten(float* dst) const;
+	//false if some mesh has neither material color nor normals- its corners are black
+	bool HasColors() const;
+
+private:
+	struct meshInstance
+	{
+		unsigned int mesh;
+		aiMatrix4x4 transform; //node to scene root
+	};
+	struct meshColor
+	{
+		bool bDiffuse;
+		aiColor3D diffuse;
+	};
+	struct faceRange
+	{
+		int instance;
+		unsigned int firstFace;
+		unsigned int faceCount;
+		int firstCorner;
+	};
+	const aiScene* scene;
+	void AddNode(const aiNode* node, const aiMatrix4x4& parent);
+	std::vector<meshInstance> instances;
+	std::vector<meshColor> colors; //per mesh
+	std::vector<faceRange> ranges;
+	int cornerCount = 0;
+};
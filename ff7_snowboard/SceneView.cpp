@@ -0,0 +1,204 @@
+#include "SceneView.h"
+#include "BinaryReader.h"
+#include "IndexedMesh.h"
+#include "ParallelFor.h"
+#include "GL/gl3w.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+
+SceneView::SceneView() : vao(0), vbo(0), ebo(0), indexCount(0), visibleCount(0), visibleIndices(0), bytes(0)
+{
+}
+
+bool SceneView::Build(const Tmd& tmd, const BinaryReader& br)
+{
+	Release();
+	std::vector<int> shown;
+	for (int i = 0; i < tmd.objectCount; i++)
+		if (tmd.objects[i].nPrims > 0 && IsDecodedMode(tmd.objects[i].firstMode))
+			shown.push_back(i);
+
+	//every object is decoded and indexed on its own, scratch body is dropped right after
+	std::vector<indexedMesh> meshes(shown.size());
+	ParallelFor((int)shown.size(), [&](int i)
+	{
+		tmdObject scratch;
+		const tmdObject& object = DecodedObject(br, tmd.objects[shown[i]], scratch);
+		std::vector<float> colors(object.polygon.size() * 9);
+		for (size_t p = 0; p < object.polygon.size(); p++)
+		{
+			const TMD_3_NS_GP& poly = object.polygon[p];
+			float rgb[9] = { poly.R0 / 256.0f, poly.G0 / 256.0f, poly.B0 / 256.0f,
+				poly.R1 / 256.0f, poly.G1 / 256.0f, poly.B1 / 256.0f,
+				poly.R2 / 256.0f, poly.G2 / 256.0f, poly.B2 / 256.0f };
+			memcpy(&colors[p * 9], rgb, sizeof(rgb));
+		}
+		BuildIndexedMesh(object, colors.data(), 3, meshes[i]);
+	});
+
+	//places of meshes in shared buffers
+	std::vector<size_t> firstVertex(meshes.size());
+	size_t vertexCount = 0;
+	size_t totalIndices = 0;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i].indices.empty())
+			continue;
+		firstVertex[i] = vertexCount;
+		vertexCount += meshes[i].vertices.size() / 6;
+		sceneObject object;
+		object.firstIndex = (unsigned int)totalIndices;
+		object.indexCount = (int)meshes[i].indices.size();
+		objects.push_back(object);
+		totalIndices += meshes[i].indices.size();
+	}
+	//offsets and counts are ints for GL
+	if (objects.empty() || totalIndices > INT_MAX || vertexCount > UINT_MAX)
+	{
+		objects.clear();
+		return false;
+	}
+
+	std::vector<float> vertices(vertexCount * 6);
+	std::vector<unsigned int> indices(totalIndices);
+	std::vector<int> sceneIndex(meshes.size(), -1);
+	for (size_t i = 0, o = 0; i < meshes.size(); i++)
+		if (!meshes[i].indices.empty())
+			sceneIndex[i] = (int)o++;
+	ParallelFor((int)meshes.size(), [&](int i)
+	{
+		indexedMesh& mesh = meshes[i];
+		if (sceneIndex[i] == -1)
+			return;
+		sceneObject& object = objects[sceneIndex[i]];
+		memcpy(&vertices[firstVertex[i] * 6], mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+		unsigned int base = (unsigned int)firstVertex[i];
+		for (size_t k = 0; k < mesh.indices.size(); k++)
+			indices[object.firstIndex + k] = mesh.indices[k] + base;
+		object.min = glm::vec3(FLT_MAX);
+		object.max = glm::vec3(-FLT_MAX);
+		for (size_t k = 0; k < mesh.vertices.size(); k += 6)
+		{
+			glm::vec3 position(mesh.vertices[k], mesh.vertices[k + 1], mesh.vertices[k + 2]);
+			object.min = glm::min(object.min, position);
+			object.max = glm::max(object.max, position);
+		}
+		std::vector<float>().swap(mesh.vertices); //frees its copy as soon as it's merged
+		std::vector<unsigned int>().swap(mesh.indices);
+	});
+	meshes.clear();
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	//same XYZRGB layout as single object meshes so the viewer's shader draws it
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glBindVertexArray(0);
+	indexCount = (int)totalIndices;
+	bytes = vertices.size() * sizeof(float) + indices.size() * sizeof(unsigned int);
+	return true;
+}
+
+void SceneView::Release()
+{
+	if (vao != 0)
+	{
+		glDeleteVertexArrays(1, &vao);
+		glDeleteBuffers(1, &vbo);
+		glDeleteBuffers(1, &ebo);
+	}
+	vao = vbo = ebo = 0;
+	objects.clear();
+	indexCount = 0;
+	visibleCount = 0;
+	visibleIndices = 0;
+	bytes = 0;
+}
+
+bool SceneView::IsBuilt() const
+{
+	return vao != 0;
+}
+
+void SceneView::Draw(const glm::mat4& projView)
+{
+	if (vao == 0)
+		return;
+	//frustum planes (xyz facing inside, w distance) are sums and differences of clip matrix rows
+	glm::vec4 row[4];
+	for (int r = 0; r < 4; r++)
+		row[r] = glm::vec4(projView[0][r], projView[1][r], projView[2][r], projView[3][r]);
+	const glm::vec4 planes[6] = { row[3] + row[0], row[3] - row[0], row[3] + row[1],
+		row[3] - row[1], row[3] + row[2], row[3] - row[2] };
+
+	drawCounts.clear();
+	drawOffsets.clear();
+	visibleCount = 0;
+	visibleIndices = 0;
+	unsigned int rangeEnd = UINT_MAX; //first index after last range
+	for (const sceneObject& object : objects)
+	{
+		bool bVisible = true;
+		for (int p = 0; p < 6 && bVisible; p++)
+		{
+			//box corner furthest along plane normal- if even that one is behind, whole box is
+			glm::vec3 corner(planes[p].x >= 0.0f ? object.max.x : object.min.x,
+				planes[p].y >= 0.0f ? object.max.y : object.min.y,
+				planes[p].z >= 0.0f ? object.max.z : object.min.z);
+			bVisible = glm::dot(glm::vec3(planes[p]), corner) + planes[p].w >= 0.0f;
+		}
+		if (!bVisible)
+			continue;
+		visibleCount++;
+		visibleIndices += object.indexCount;
+		//neighbours in EBO are drawn as one range
+		if (object.firstIndex == rangeEnd)
+			drawCounts.back() += object.indexCount;
+		else
+		{
+			drawCounts.push_back(object.indexCount);
+			drawOffsets.push_back((const void*)(object.firstIndex * sizeof(unsigned int)));
+		}
+		rangeEnd = object.firstIndex + object.indexCount;
+	}
+	if (drawCounts.empty())
+		return;
+	glBindVertexArray(vao);
+	glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(), (int)drawCounts.size());
+	glBindVertexArray(0);
+}
+
+int SceneView::ObjectCount() const
+{
+	return (int)objects.size();
+}
+
+int SceneView::VisibleCount() const
+{
+	return visibleCount;
+}
+
+int SceneView::TriangleCount() const
+{
+	return indexCount / 3;
+}
+
+int SceneView::VisibleTriangles() const
+{
+	return visibleIndices / 3;
+}
+
+size_t SceneView::Bytes() const
+{
+	return bytes;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "glm/glm.hpp"
+#include "Tmd.h"
+
+class BinaryReader;
+
+//Every object of the archive at once, placed where the file puts them. All indexed meshes share one VBO
+//and EBO (indices rebased to the shared VBO) so a frame is one glMultiDrawElements over objects whose
+//bounding boxes touch the view frustum- culling is done on CPU, so software GL only rasterizes what is seen.
+//Shows objects as they are in the file, so it has to be rebuilt after the file is saved or reopened.
+//Needs current GL context for every call but the stats
+class SceneView
+{
+public:
+	SceneView();
+	//decodes every object shown by the viewer (bodies in objectCache aren't touched) and uploads them.
+	//Returns false if nothing could be shown
+	bool Build(const Tmd& tmd, const BinaryReader& br);
+	//deletes GL objects, IsBuilt is false after
+	void Release();
+	bool IsBuilt() const;
+	//culls against frustum of projView (projection*view, model is identity) and draws what is left
+	void Draw(const glm::mat4& projView);
+	int ObjectCount() const;
+	int VisibleCount() const; //of last Draw
+	int TriangleCount() const;
+	int VisibleTriangles() const; //of last Draw
+	size_t Bytes() const;
+
+private:
+	struct sceneObject
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		unsigned int firstIndex; //into shared EBO
+		int indexCount;
+	};
+	unsigned int vao, vbo, ebo;
+	std::vector<sceneObject> objects; //in file order, objects without triangles left out
+	std::vector<int> drawCounts; //ranges of last Draw, reused so frames don't allocate
+	std::vector<const void*> drawOffsets;
+	int indexCount;
+	int visibleCount;
+	int visibleIndices;
+	size_t bytes;
+};
@@ -0,0 +1,362 @@
+#include "Tmd.h"
+#include "BinaryReader.h"
+#include "ParallelFor.h"
+#include <cstring>
+#include <cstdio>
+#include <ios>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TMD_SSE2
+#endif
+
+static_assert(sizeof(vertex) == 4 * sizeof(float), "vertex has to be tightly packed XYZW");
+static_assert(sizeof(TMD_3_NS_GP) == 24, "TMD_3_NS_GP has to match on-disk polygon record");
+
+static float DecodeComponent(const unsigned char* p)
+{
+	return (short)(p[0] | (p[1] << 8)) / 100.0f;
+}
+
+//divps is correctly rounded just like scalar division so SIMD output matches scalar bit for bit.
+//Don't replace it with multiplication by 0.01f
+void DecodeVertices(const unsigned char* src, int count, vertex* dst)
+{
+	int i = 0;
+#if defined(TMD_AVX2) || defined(TMD_SSE2)
+	float* out = (float*)dst;
+#endif
+#if defined(TMD_AVX2)
+	const __m256 divisor = _mm256_set1_ps(100.0f);
+	for (; i + 4 <= count; i += 4) //4 vertices = 16 shorts per iteration
+	{
+		__m128i lo = _mm_loadu_si128((const __m128i*)(src + i * 8));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(src + i * 8 + 16));
+		__m256 a = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(lo)), divisor);
+		__m256 b = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(hi)), divisor);
+		_mm256_storeu_ps(out + i * 4, a);
+		_mm256_storeu_ps(out + i * 4 + 8, b);
+	}
+#elif defined(TMD_SSE2)
+	const __m128 divisor = _mm_set1_ps(100.0f);
+	for (; i + 2 <= count; i += 2) //2 vertices = 8 shorts per iteration
+	{
+		__m128i packed = _mm_loadu_si128((const __m128i*)(src + i * 8));
+		//sign extend int16 to int32 by placing each short in the upper half and shifting back
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+		_mm_storeu_ps(out + i * 4, _mm_div_ps(_mm_cvtepi32_ps(lo), divisor));
+		_mm_storeu_ps(out + i * 4 + 4, _mm_div_ps(_mm_cvtepi32_ps(hi), divisor));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const unsigned char* p = src + i * 8;
+		dst[i].x = DecodeComponent(p);
+		dst[i].y = DecodeComponent(p + 2);
+		dst[i].z = DecodeComponent(p + 4);
+		dst[i].w = DecodeComponent(p + 6);
+	}
+}
+
+static void CopyColor(const unsigned char* src, unsigned char* r, unsigned char* g, unsigned char* b)
+{
+	*r = src[0];
+	*g = src[1];
+	*b = src[2];
+}
+
+static unsigned short ReadIndex(const unsigned char* p)
+{
+	return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+//colors point at RGB of V0 V1 V2 (and V3), indices at V0 V1 V2 (V3) shorts
+static void PushTriangle(std::vector<TMD_3_NS_GP>& dst, const unsigned char* c0, const unsigned char* c1, const unsigned char* c2,
+	unsigned short a, unsigned short b, unsigned short c)
+{
+	TMD_3_NS_GP poly = TMD_3_NS_GP();
+	poly.MODE = TMD_MODE_3_NS_GP;
+	poly.mode2 = 0x31;
+	CopyColor(c0, &poly.R0, &poly.G0, &poly.B0);
+	CopyColor(c1, &poly.R1, &poly.G1, &poly.B1);
+	CopyColor(c2, &poly.R2, &poly.G2, &poly.B2);
+	poly.A = a;
+	poly.B = b;
+	poly.C = c;
+	dst.push_back(poly);
+}
+
+int DecodePolygons(const unsigned char* src, int size, int count, std::vector<TMD_3_NS_GP>& dst)
+{
+	int offset = 0;
+	int i = 0;
+	while (i < count)
+	{
+		//gouraud triangles are what the game mostly uses- runs of them are still one copy each,
+		//records are little-endian just like every platform this tool targets
+		int run = 0;
+		while (i + run < count && offset + (run + 1) * 24 <= size && memcmp(src + offset + run * 24, "\x06\x05\x01\x31", 4) == 0)
+			run++;
+		if (run > 0)
+		{
+			size_t first = dst.size();
+			dst.resize(first + run);
+			memcpy(&dst[first], src + offset, run * sizeof(TMD_3_NS_GP));
+			offset += run * 24;
+			i += run;
+			continue;
+		}
+		if (offset + 4 > size)
+			return -1;
+		const unsigned char* p = src + offset;
+		unsigned int mode = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+		int recordSize = 4 + p[1] * 4;
+		if (offset + recordSize > size)
+			return -1;
+		if (mode == TMD_MODE_3_NS_FP)
+			PushTriangle(dst, p + 4, p + 4, p + 4, ReadIndex(p + 8), ReadIndex(p + 10), ReadIndex(p + 12));
+		else if (mode == TMD_MODE_4_NS_FP)
+		{
+			PushTriangle(dst, p + 4, p + 4, p + 4, ReadIndex(p + 8), ReadIndex(p + 10), ReadIndex(p + 12));
+			PushTriangle(dst, p + 4, p + 4, p + 4, ReadIndex(p + 10), ReadIndex(p + 14), ReadIndex(p + 12));
+		}
+		else if (mode == TMD_MODE_4_NS_GP)
+		{
+			PushTriangle(dst, p + 4, p + 8, p + 12, ReadIndex(p + 20), ReadIndex(p + 22), ReadIndex(p + 24));
+			PushTriangle(dst, p + 8, p + 16, p + 12, ReadIndex(p + 22), ReadIndex(p + 26), ReadIndex(p + 24));
+		}
+		else
+		{
+			TMD_3_NS_GP unknown = TMD_3_NS_GP();
+			memcpy(&unknown, p, std::min(recordSize, (int)sizeof(TMD_3_NS_GP)));
+			dst.push_back(unknown);
+		}
+		offset += recordSize;
+		i++;
+	}
+	return offset;
+}
+
+std::map<unsigned int, int> CountUnknownModes(const tmdObject& object)
+{
+	std::map<unsigned int, int> modes;
+	for (const TMD_3_NS_GP& poly : object.polygon)
+		if (poly.MODE != TMD_MODE_3_NS_GP)
+			modes[poly.MODE]++;
+	return modes;
+}
+
+std::string DescribeUnknownModes(int objectIndex, const tmdObject& object)
+{
+	std::map<unsigned int, int> unknownModes = CountUnknownModes(object);
+	if (unknownModes.empty())
+		return std::string();
+	std::string output = "Object " + std::to_string(objectIndex) + "- polygons that were not 0x06050131:";
+	for (auto& mode : unknownModes)
+	{
+		char localn[32];
+		std::snprintf(localn, 32, " %08X x%d", mode.first, mode.second);
+		output.append(localn);
+	}
+	output.append("\n");
+	return output;
+}
+
+int MeasurePrimitives(const unsigned char* src, int size, int count)
+{
+	int offset = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (offset + 4 > size)
+			return -1;
+		offset += 4 + src[offset + 1] * 4;
+		if (offset > size)
+			return -1;
+	}
+	return offset;
+}
+
+//empty vertex block is fine wherever it points, same as empty primitive block
+static const unsigned char* VertexBlock(const BinaryReader& br, const tmdObject& object)
+{
+	if (object.nVerts <= 0 || object.nVerts > br.size() / 8)
+		return NULL;
+	return br.GetSpan(object.pVerts + 12, object.nVerts * 8);
+}
+
+//records differ in size so block size is known only after walking it- span reaches end of file
+static const unsigned char* PrimitiveBlock(const BinaryReader& br, const tmdObject& object, int& limit)
+{
+	limit = br.size() - (object.pPrims + 12);
+	if (object.nPrims < 0 || object.nPrims > br.size() / 4 || limit < 0)
+		return NULL;
+	return br.GetSpan(object.pPrims + 12, limit);
+}
+
+bool DecodeObject(const BinaryReader& br, tmdObject& object)
+{
+	bool bInBounds = true;
+	const unsigned char* vertBlock = VertexBlock(br, object);
+	object.vertices.clear();
+	object.polygon.clear(); //DecodePolygons appends- decoding object again mustn't double its polygons
+	if (vertBlock != NULL)
+	{
+		object.vertices.resize(object.nVerts);
+		DecodeVertices(vertBlock, object.nVerts, object.vertices.data());
+	}
+	else if (object.nVerts != 0)
+		bInBounds = false;
+	int polyBlockLimit;
+	const unsigned char* polyBlock = PrimitiveBlock(br, object, polyBlockLimit);
+	object.primBlockSize = 0;
+	if (polyBlock != NULL)
+	{
+		object.polygon.reserve(object.nPrims);
+		object.primBlockSize = DecodePolygons(polyBlock, polyBlockLimit, object.nPrims, object.polygon);
+	}
+	if (object.primBlockSize < 0 || (polyBlock == NULL && object.nPrims != 0))
+	{
+		object.polygon.clear();
+		object.primBlockSize = 0;
+		bInBounds = false;
+	}
+	object.bDecoded = true;
+	return bInBounds;
+}
+
+bool MeasureObject(const BinaryReader& br, const tmdObject& object, int& vertexCount, int& primBlockSize)
+{
+	if (object.bDecoded)
+	{
+		vertexCount = (int)object.vertices.size();
+		primBlockSize = object.primBlockSize;
+	}
+	else
+	{
+		vertexCount = VertexBlock(br, object) != NULL ? object.nVerts : 0;
+		int polyBlockLimit;
+		const unsigned char* polyBlock = PrimitiveBlock(br, object, polyBlockLimit);
+		primBlockSize = polyBlock != NULL ? MeasurePrimitives(polyBlock, polyBlockLimit, object.nPrims) : 0;
+		if (primBlockSize < 0)
+			primBlockSize = 0;
+	}
+	return vertexCount == object.nVerts && (object.nPrims == 0 || primBlockSize != 0);
+}
+
+const tmdObject& DecodedObject(const BinaryReader& br, const tmdObject& object, tmdObject& scratch)
+{
+	if (object.bDecoded)
+		return object;
+	scratch = object;
+	DecodeObject(br, scratch);
+	return scratch;
+}
+
+bool IsDecodedMode(unsigned int mode)
+{
+	return mode == TMD_MODE_3_NS_GP || mode == TMD_MODE_3_NS_FP || mode == TMD_MODE_4_NS_FP || mode == TMD_MODE_4_NS_GP;
+}
+
+void AppendObjectErrors(int index, const tmdObject& object, std::vector<tmdError>& errors)
+{
+	//blocks are checked on their own- DecodeObject leaves vertices empty when vertex block is outside of
+	//file and primBlockSize 0 when primitive records couldn't be walked
+	if ((int)object.vertices.size() != object.nVerts)
+		errors.push_back({ TMD_TRUNCATED, TMD_BLOCK_VERTICES, index, object.pVerts + 12 });
+	if (object.nPrims != 0 && object.primBlockSize == 0)
+		errors.push_back({ TMD_TRUNCATED, TMD_BLOCK_PRIMITIVES, index, object.pPrims + 12 });
+}
+
+//header and object table through reader's cursor
+static TmdStatus ReadTable(BinaryReader& br, Tmd& tmd, std::vector<tmdError>& errors, const std::function<void(int, int)>& progress)
+{
+	tmd = Tmd();
+	tmd.objectCount = 0;
+	errors.clear();
+	unsigned int tmdVersion = br.ReadUInt32();
+	if (tmdVersion != 0x41)
+	{
+		errors.push_back({ TMD_INVALID_VERSION, TMD_BLOCK_HEADER, -1, 0 });
+		return TMD_INVALID_VERSION;
+	}
+	br.seek(4, std::ios::cur);
+	int objectCount = br.ReadInt32();
+	if (br.bOutOfBounds || objectCount < 0 || objectCount > (br.size() - 12) / 28) //28 bytes per object header
+	{
+		errors.push_back({ TMD_TRUNCATED, br.bOutOfBounds ? TMD_BLOCK_HEADER : TMD_BLOCK_OBJECT_TABLE, -1, br.bOutOfBounds ? 0 : 12 });
+		return TMD_TRUNCATED;
+	}
+	tmd.objectCount = objectCount;
+	tmd.objects.resize(tmd.objectCount);
+	for (int i = 0; i < tmd.objectCount; i++)
+	{
+		tmdObject& object = tmd.objects[i];
+		object.pVerts = br.ReadUInt32();
+		object.nVerts = br.ReadUInt32();
+		object.pNorms = br.ReadUInt32();
+		object.nNorms = br.ReadUInt32();
+		object.pPrims = br.ReadUInt32();
+		object.nPrims = br.ReadUInt32();
+		object.scale = br.ReadUInt32();
+		const unsigned char* mode = object.nPrims > 0 ? br.GetSpan(object.pPrims + 12, 4) : NULL;
+		if (mode != NULL)
+			object.firstMode = mode[0] | (mode[1] << 8) | (mode[2] << 16) | ((unsigned int)mode[3] << 24);
+		if (progress && (i & 1023) == 0)
+			progress(i, tmd.objectCount);
+	}
+	if (progress)
+		progress(tmd.objectCount, tmd.objectCount);
+	return TMD_OK;
+}
+
+TmdStatus ParseTmd(const unsigned char* data, int size, Tmd& tmd, std::vector<tmdError>& errors)
+{
+	BinaryReader br(data, size); //local view- its cursor is what keeps parses apart
+	TmdStatus status = ReadTable(br, tmd, errors, nullptr);
+	if (status != TMD_OK)
+		return status;
+
+	//all block offsets are known now, so object bodies are decoded in parallel straight from the mapping.
+	//Each job writes only its own tmd.objects[i] so order is the same as in file.
+	//Small archives aren't worth waking threads for
+	long long totalRecords = 0;
+	for (int i = 0; i < tmd.objectCount; i++)
+		totalRecords += std::max(tmd.objects[i].nVerts, 0) / 64 + std::max(tmd.objects[i].nPrims, 0) / 64;
+	std::vector<char> bBroken(tmd.objectCount);
+	ParallelFor(tmd.objectCount, [&](int i)
+	{
+		bBroken[i] = !DecodeObject(br, tmd.objects[i]);
+	}, totalRecords < 1024 ? 1 : 0);
+	for (int i = 0; i < tmd.objectCount; i++)
+		if (bBroken[i])
+			AppendObjectErrors(i, tmd.objects[i], errors);
+	return errors.empty() ? TMD_OK : TMD_TRUNCATED;
+}
+
+TmdStatus ParseTmd(const BinaryReader& br, Tmd& tmd, std::vector<tmdError>& errors)
+{
+	return ParseTmd(br.GetSpan(0, br.size()), br.size(), tmd, errors);
+}
+
+TmdStatus ParseTmdTable(const BinaryReader& br, Tmd& tmd, std::vector<tmdError>& errors, const std::function<void(int, int)>& progress)
+{
+	BinaryReader view(br.GetSpan(0, br.size()), br.size());
+	return ReadTable(view, tmd, errors, progress);
+}
+
+std::string DescribeTmdError(const tmdError& error)
+{
+	static const char* blockNames[] = { "header", "object table", "vertices", "primitives", "normals" };
+	char localn[128];
+	if (error.status == TMD_INVALID_VERSION)
+		std::snprintf(localn, 128, "not a FFVII TMD file- version isn't 0x41");
+	else if (error.object < 0)
+		std::snprintf(localn, 128, "%s at 0x%X is outside of file", blockNames[error.block], error.offset);
+	else
+		std::snprintf(localn, 128, "object %d: %s at 0x%X are outside of file", error.object, blockNames[error.block], error.offset);
+	return std::string(localn);
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include <functional>
+
+class BinaryReader;
+
+//MODE of 3 vertex gouraud shaded non-textured triangle- every primitive the tool understands is
+//decoded into this one, so the rest of the tool only deals with gouraud triangles
+const unsigned int TMD_MODE_3_NS_GP = 0x31010506;
+//flat (one color) triangle, flat and gouraud 4 vertex polygons, all without texture and light source.
+//4 vertex polygons are drawn as triangles V0 V1 V2 and V1 V3 V2
+const unsigned int TMD_MODE_3_NS_FP = 0x21010304;
+const unsigned int TMD_MODE_4_NS_FP = 0x29010305;
+const unsigned int TMD_MODE_4_NS_GP = 0x39010608;
+
+struct TMD_3_NS_GP
+{
+	unsigned int MODE;
+	unsigned char R0, G0, B0, mode2, R1, G1, B1, pad1, R2, G2, B2, pad2;
+	unsigned short A, B, C, pad;
+};
+
+struct vertex
+{
+	float x;
+	float y;
+	float z;
+	float w;
+};
+
+struct tmdObject
+{
+	int pVerts;
+	int nVerts;
+	int pNorms;
+	int nNorms;
+	int pPrims;
+	int nPrims;
+	int scale;
+	int primBlockSize = 0; //bytes of primitive block in file, known after decoding
+	unsigned int firstMode = 0; //MODE of first primitive record, read with the object table
+	bool bDecoded = false; //vertices and polygon are filled- bodies can be decoded lazily, see ObjectCache
+	std::vector<vertex> vertices;
+	std::vector<TMD_3_NS_GP> polygon;
+};
+
+struct Tmd
+{
+	int objectCount;
+	std::vector<tmdObject> objects;
+};
+
+enum TmdStatus
+{
+	TMD_OK,
+	TMD_INVALID_VERSION,
+	TMD_TRUNCATED //header or some object blocks point outside of file- those objects are left empty
+};
+
+//part of file a tmdError points at
+enum TmdBlock
+{
+	TMD_BLOCK_HEADER,
+	TMD_BLOCK_OBJECT_TABLE,
+	TMD_BLOCK_VERTICES,
+	TMD_BLOCK_PRIMITIVES,
+	TMD_BLOCK_NORMALS //only checked by SaveTmd- bodies are decoded without normals
+};
+
+struct tmdError
+{
+	TmdStatus status;
+	TmdBlock block;
+	int object; //-1 for header and object table
+	int offset; //file offset where the block starts
+};
+
+//parses size bytes at data into tmd. Touches nothing but its arguments, so any number of parses can run
+//at once from any threads. data only has to stay valid during the call- tmd doesn't point into it.
+//errors gets one entry per broken block, returned status is the worst of them
+TmdStatus ParseTmd(const unsigned char* data, int size, Tmd& tmd, std::vector<tmdError>& errors);
+
+//parses whole TMD mapped by br. br has to be opened- only its mapping is read, cursor isn't moved
+TmdStatus ParseTmd(const BinaryReader& br, Tmd& tmd, std::vector<tmdError>& errors);
+
+//reads only header and object table- bodies are left for DecodeObject, so it takes the same time for
+//archive of any size. Errors are only about header and table. progress, if given, is called now and then
+//with objects read so far and object count- table pages come from disk as they are touched
+TmdStatus ParseTmdTable(const BinaryReader& br, Tmd& tmd, std::vector<tmdError>& errors,
+	const std::function<void(int, int)>& progress = nullptr);
+
+//true for MODEs DecodePolygons turns into gouraud triangles
+bool IsDecodedMode(unsigned int mode);
+
+//appends errors of object DecodeObject returned false for
+void AppendObjectErrors(int index, const tmdObject& object, std::vector<tmdError>& errors);
+
+//block sizes DecodeObject finds (or found) for object without decoding it- records are only walked by
+//their ilen. vertexCount is 0 if vertex block is outside of file, primBlockSize 0 if records can't be
+//walked. Returns what DecodeObject returns
+bool MeasureObject(const BinaryReader& br, const tmdObject& object, int& vertexCount, int& primBlockSize);
+
+//object itself if its body is decoded, otherwise body decoded into scratch- lets writers walk every
+//object while only one extra body is in memory
+const tmdObject& DecodedObject(const BinaryReader& br, const tmdObject& object, tmdObject& scratch);
+
+//one line report of error for message boxes and logs
+std::string DescribeTmdError(const tmdError& error);
+
+//decodes vertices and polygons of object whose header is already filled in.
+//Only reads br so many objects can be decoded at once. Returns false if any block is outside of file
+bool DecodeObject(const BinaryReader& br, tmdObject& object);
+
+//converts count packed int16 XYZW records (8 bytes each) into vertices divided by 100.0f
+//uses AVX2/SSE2 when compiled for it- result is bit identical to the scalar path
+void DecodeVertices(const unsigned char* src, int count, vertex* dst);
+
+//decodes count primitive records from size bytes at src into gouraud triangles appended to dst. Records
+//are walked by their ilen so unknown primitives are skipped properly- they are kept with their own MODE
+//and first 20 bytes. Returns bytes used or -1 if records run past size
+int DecodePolygons(const unsigned char* src, int size, int count, std::vector<TMD_3_NS_GP>& dst);
+
+//bytes count primitive records from size bytes at src take, walked like DecodePolygons does but without
+//decoding them. -1 if records run past size
+int MeasurePrimitives(const unsigned char* src, int size, int count);
+
+//histogram of polygon MODEs that couldn't be decoded- MODE -> number of polygons
+std::map<unsigned int, int> CountUnknownModes(const tmdObject& object);
+
+//one line debug report of CountUnknownModes or empty string if object has only known polygons
+std::string DescribeUnknownModes(int objectIndex, const tmdObject& object);
@@ -0,0 +1,206 @@
+#include "TmdExport.h"
+#include "ObjWriter.h"
+#include <fstream>
+#include <cstdio>
+#include <cfloat>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+
+struct exportCorner
+{
+	float x, y, z;
+	unsigned char r, g, b;
+};
+
+//expands polygons into three corners each. Polygons pointing at missing vertices are skipped
+static std::vector<exportCorner> ExpandCorners(const tmdObject& object)
+{
+	std::vector<exportCorner> corners;
+	corners.reserve(object.polygon.size() * 3);
+	int nVerts = (int)object.vertices.size();
+	for (const TMD_3_NS_GP& poly : object.polygon)
+	{
+		if (poly.A >= nVerts || poly.B >= nVerts || poly.C >= nVerts)
+			continue;
+		const vertex& a = object.vertices[poly.A];
+		const vertex& b = object.vertices[poly.B];
+		const vertex& c = object.vertices[poly.C];
+		corners.push_back({ a.x * 100.0f, -a.y * 100.0f, a.z * 100.0f, poly.R0, poly.G0, poly.B0 });
+		corners.push_back({ b.x * 100.0f, -b.y * 100.0f, b.z * 100.0f, poly.R1, poly.G1, poly.B1 });
+		corners.push_back({ c.x * 100.0f, -c.y * 100.0f, c.z * 100.0f, poly.R2, poly.G2, poly.B2 });
+	}
+	return corners;
+}
+
+bool ExportObj(const tmdObject& object, const float* cornerColors, int cornerStride, int cornerCount, const std::string& path)
+{
+	ObjWriter writer(path);
+	if (!writer.IsOpen())
+		return false;
+	for (const vertex& v : object.vertices)
+		writer.WriteVertex(
+			(float)((double)v.x * 100.0f),
+			(float)((double)-v.y * 100.0f),
+			(float)((double)v.z * 100.0f));
+	int polyCount = std::min((int)object.polygon.size(), cornerCount / 3);
+	for (int i = 0; i < polyCount; i++)
+	{
+		const float* a = cornerColors + (i * 3) * cornerStride;
+		const float* b = cornerColors + (i * 3 + 1) * cornerStride;
+		const float* c = cornerColors + (i * 3 + 2) * cornerStride;
+		int na = writer.WriteColor(a[0], a[1], a[2]);
+		int nb = writer.WriteColor(b[0], b[1], b[2]);
+		int nc = writer.WriteColor(c[0], c[1], c[2]);
+		writer.WriteFace(object.polygon[i].A + 1, na, object.polygon[i].B + 1, nb, object.polygon[i].C + 1, nc);
+	}
+	return writer.Close();
+}
+
+bool ExportObj(const tmdObject& object, const std::string& path)
+{
+	std::vector<float> colors(object.polygon.size() * 9);
+	for (size_t i = 0; i < object.polygon.size(); i++)
+	{
+		const TMD_3_NS_GP& poly = object.polygon[i];
+		float rgb[9] = { poly.R0 / 256.0f, poly.G0 / 256.0f, poly.B0 / 256.0f,
+			poly.R1 / 256.0f, poly.G1 / 256.0f, poly.B1 / 256.0f,
+			poly.R2 / 256.0f, poly.G2 / 256.0f, poly.B2 / 256.0f };
+		memcpy(&colors[i * 9], rgb, sizeof(rgb));
+	}
+	return ExportObj(object, colors.data(), 3, (int)colors.size() / 3, path);
+}
+
+bool ExportPly(const tmdObject& object, const std::string& path)
+{
+	std::vector<exportCorner> corners = ExpandCorners(object);
+	std::ofstream fdout(path, std::ios::out | std::ios::binary);
+	if (!fdout.is_open())
+		return false;
+	int faceCount = (int)corners.size() / 3;
+	char header[512];
+	std::snprintf(header, 512,
+		"ply\n"
+		"format binary_little_endian 1.0\n"
+		"element vertex %d\n"
+		"property float x\nproperty float y\nproperty float z\n"
+		"property uchar red\nproperty uchar green\nproperty uchar blue\n"
+		"element face %d\n"
+		"property list uchar int vertex_indices\n"
+		"end_header\n", (int)corners.size(), faceCount);
+	fdout << header;
+
+	//15 bytes per vertex and 13 per face, packed by hand as PLY has no padding
+	std::vector<char> body(corners.size() * 15 + faceCount * 13);
+	char* p = body.data();
+	for (const exportCorner& corner : corners)
+	{
+		memcpy(p, &corner.x, 12);
+		p[12] = corner.r;
+		p[13] = corner.g;
+		p[14] = corner.b;
+		p += 15;
+	}
+	for (int i = 0; i < faceCount; i++)
+	{
+		int face[3] = { i * 3, i * 3 + 1, i * 3 + 2 };
+		*p++ = 3;
+		memcpy(p, face, sizeof(face));
+		p += sizeof(face);
+	}
+	fdout.write(body.data(), body.size());
+	fdout.close();
+	return !fdout.fail();
+}
+
+bool ExportGltf(const tmdObject& object, const std::string& path)
+{
+	std::vector<exportCorner> corners = ExpandCorners(object);
+	int count = (int)corners.size();
+	std::vector<float> positions(count * 3);
+	std::vector<float> colors(count * 3);
+	float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int i = 0; i < count; i++)
+	{
+		const float* xyz = &corners[i].x;
+		for (int k = 0; k < 3; k++)
+		{
+			positions[i * 3 + k] = xyz[k];
+			if (xyz[k] < min[k]) min[k] = xyz[k];
+			if (xyz[k] > max[k]) max[k] = xyz[k];
+		}
+		colors[i * 3] = corners[i].r / 255.0f;
+		colors[i * 3 + 1] = corners[i].g / 255.0f;
+		colors[i * 3 + 2] = corners[i].b / 255.0f;
+	}
+	if (count == 0)
+		for (int k = 0; k < 3; k++)
+			min[k] = max[k] = 0.0f;
+
+	//extension is only stripped from file name- dot of a directory like "ff7.mods/course" isn't one
+	size_t slash = path.find_last_of("/\\");
+	size_t dot = path.find_last_of('.');
+	if (dot != std::string::npos && slash != std::string::npos && dot < slash)
+		dot = std::string::npos;
+	std::string binPath = path.substr(0, dot) + ".bin";
+	std::string binName = slash == std::string::npos ? binPath : binPath.substr(slash + 1);
+	size_t viewSize = (size_t)count * 3 * sizeof(float);
+
+	std::ofstream fdbin(binPath, std::ios::out | std::ios::binary);
+	if (!fdbin.is_open())
+		return false;
+	fdbin.write((const char*)positions.data(), viewSize);
+	fdbin.write((const char*)colors.data(), viewSize);
+	fdbin.close();
+	if (fdbin.fail())
+	{
+		std::remove(binPath.c_str());
+		return false;
+	}
+
+	//file name goes into JSON as relative URI- everything but unreserved characters is percent-encoded,
+	//so quotes, backslashes and spaces in the name can't break either of them
+	std::string uri;
+	for (unsigned char c : binName)
+	{
+		if (isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~')
+			uri += (char)c;
+		else
+		{
+			char escaped[4];
+			std::snprintf(escaped, sizeof(escaped), "%%%02X", c);
+			uri += escaped;
+		}
+	}
+	std::string json =
+		"{\n"
+		"\"asset\":{\"version\":\"2.0\",\"generator\":\"ff7_snowboardTool\"},\n"
+		"\"scene\":0,\n"
+		"\"scenes\":[{\"nodes\":[0]}],\n"
+		"\"nodes\":[{\"mesh\":0}],\n"
+		"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"COLOR_0\":1},\"mode\":4}]}],\n"
+		"\"buffers\":[{\"uri\":\"" + uri + "\",\"byteLength\":" + std::to_string(viewSize * 2) + "}],\n"
+		"\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + std::to_string(viewSize) + ",\"target\":34962},"
+		"{\"buffer\":0,\"byteOffset\":" + std::to_string(viewSize) + ",\"byteLength\":" + std::to_string(viewSize) + ",\"target\":34962}],\n";
+	char bounds[256]; //6 floats of %.9g are at most 16 characters each
+	std::snprintf(bounds, sizeof(bounds), "\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]",
+		min[0], min[1], min[2], max[0], max[1], max[2]);
+	json += "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":" + std::to_string(count) + ",\"type\":\"VEC3\"," + bounds + "},"
+		"{\"bufferView\":1,\"componentType\":5126,\"count\":" + std::to_string(count) + ",\"type\":\"VEC3\"}]\n"
+		"}\n";
+
+	//.bin without .gltf (or half written .gltf) is of no use, neither is left behind
+	std::ofstream fdout(path, std::ios::out);
+	if (fdout.is_open())
+	{
+		fdout.write(json.data(), json.size());
+		fdout.close();
+		if (!fdout.fail())
+			return true;
+		std::remove(path.c_str());
+	}
+	std::remove(binPath.c_str());
+	return false;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+#include "Tmd.h"
+
+//Writers of a single TMD object to common mesh formats. All of them write raw TMD units with Y flipped,
+//same as the viewer shows the model. Return false if file couldn't be written
+
+//Wavefront OBJ- polygon colors are stored as vn entries, each distinct color once
+bool ExportObj(const tmdObject& object, const std::string& path);
+
+//same as above but corner colors come from cornerColors (RGB read with cornerStride floats step,
+//corners in polygon order A, B, C) instead of the TMD- used for edited pigments
+bool ExportObj(const tmdObject& object, const float* cornerColors, int cornerStride, int cornerCount, const std::string& path);
+
+//binary little-endian PLY with per-corner uchar colors
+bool ExportPly(const tmdObject& object, const std::string& path);
+
+//glTF 2.0 .gltf with POSITION and COLOR_0 in .bin file next to it
+bool ExportGltf(const tmdObject& object, const std::string& path);
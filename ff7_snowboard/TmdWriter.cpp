@@ -0,0 +1,529 @@
+#include "TmdWriter.h"
+#include "BinaryReader.h"
+#include "VertexWeld.h"
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#ifdef _WIN32
+#include <Windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static void PutUInt16(char* p, unsigned short value)
+{
+	p[0] = (char)(value & 0xFF);
+	p[1] = (char)(value >> 8);
+}
+
+static void PutUInt32(char* p, unsigned int value)
+{
+	p[0] = (char)(value & 0xFF);
+	p[1] = (char)((value >> 8) & 0xFF);
+	p[2] = (char)((value >> 16) & 0xFF);
+	p[3] = (char)(value >> 24);
+}
+
+//two triangles become one 4 vertex polygon only if their normals are at most ~1.8 degree apart
+static const double QUAD_MIN_COS = 0.9995;
+
+bool BuildCornerObject(const float* corners, int cornerCount, int weldDistance, std::vector<short>& positions, std::vector<TMD_3_NS_GP>& polygons)
+{
+	int polyCount = cornerCount / 3;
+	std::vector<short> cornerPositions(cornerCount * 3);
+	for (int i = 0; i < cornerCount; i++)
+	{
+		const float* corner = corners + i * 6;
+		cornerPositions[i * 3] = (short)lrintf(corner[0] * 100.0f);
+		cornerPositions[i * 3 + 1] = (short)lrintf(-corner[1] * 100.0f);
+		cornerPositions[i * 3 + 2] = (short)lrintf(corner[2] * 100.0f);
+	}
+	std::vector<int> remap;
+	std::vector<int> welded;
+	WeldPositions(cornerPositions.data(), cornerCount, weldDistance, remap, welded);
+	if (welded.size() > 0x10000)
+		return false; //polygons couldn't address all vertices
+
+	positions.assign(welded.size() * 4, 0); //W stays zero
+	for (size_t i = 0; i < welded.size(); i++)
+		memcpy(&positions[i * 4], &cornerPositions[welded[i] * 3], 3 * sizeof(short));
+	polygons.assign(polyCount, TMD_3_NS_GP());
+	for (int i = 0; i < polyCount; i++)
+	{
+		const float* corner = corners + i * 18;
+		unsigned char* rgb = &polygons[i].R0;
+		for (int k = 0; k < 3; k++)
+		{
+			rgb[k * 4] = (unsigned char)(fabsf(corner[k * 6 + 3]) * 255.0f);
+			rgb[k * 4 + 1] = (unsigned char)(fabsf(corner[k * 6 + 4]) * 255.0f);
+			rgb[k * 4 + 2] = (unsigned char)(fabsf(corner[k * 6 + 5]) * 255.0f);
+		}
+		polygons[i].MODE = TMD_MODE_3_NS_GP;
+		polygons[i].mode2 = 0x31;
+		polygons[i].A = (unsigned short)remap[i * 3];
+		polygons[i].B = (unsigned short)remap[i * 3 + 1];
+		polygons[i].C = (unsigned short)remap[i * 3 + 2];
+	}
+	return true;
+}
+
+static const unsigned char* CornerRGB(const TMD_3_NS_GP& poly, int corner)
+{
+	return &poly.R0 + corner * 4;
+}
+
+static unsigned short CornerIndex(const TMD_3_NS_GP& poly, int corner)
+{
+	return corner == 0 ? poly.A : corner == 1 ? poly.B : poly.C;
+}
+
+static bool IsFlat(const TMD_3_NS_GP& poly)
+{
+	return memcmp(CornerRGB(poly, 0), CornerRGB(poly, 1), 3) == 0 && memcmp(CornerRGB(poly, 0), CornerRGB(poly, 2), 3) == 0;
+}
+
+static void Normal(const short* positions, const TMD_3_NS_GP& poly, double* n)
+{
+	const short* a = positions + poly.A * 4;
+	const short* b = positions + poly.B * 4;
+	const short* c = positions + poly.C * 4;
+	double u[3] = { (double)b[0] - a[0], (double)b[1] - a[1], (double)b[2] - a[2] };
+	double v[3] = { (double)c[0] - a[0], (double)c[1] - a[1], (double)c[2] - a[2] };
+	n[0] = u[1] * v[2] - u[2] * v[1];
+	n[1] = u[2] * v[0] - u[0] * v[2];
+	n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+//corner of poly at given vertex, -1 if poly doesn't use it
+static int FindCorner(const TMD_3_NS_GP& poly, unsigned short vertex)
+{
+	for (int k = 0; k < 3; k++)
+		if (CornerIndex(poly, k) == vertex)
+			return k;
+	return -1;
+}
+
+//0- can't be joined, 1- gouraud quad, 2- flat quad. Shared edge is corner k -> k+1 of first
+static int QuadKind(const short* positions, const TMD_3_NS_GP& first, int k, const TMD_3_NS_GP& second)
+{
+	unsigned short b = CornerIndex(first, k);
+	unsigned short c = CornerIndex(first, (k + 1) % 3);
+	int secondB = FindCorner(second, b);
+	int secondC = FindCorner(second, c);
+	int secondD = 3 - secondB - secondC;
+	if (secondB == -1 || secondC == -1 || FindCorner(first, CornerIndex(second, secondD)) != -1)
+		return 0;
+	if (memcmp(CornerRGB(first, k), CornerRGB(second, secondB), 3) != 0
+		|| memcmp(CornerRGB(first, (k + 1) % 3), CornerRGB(second, secondC), 3) != 0)
+		return 0;
+	double n1[3];
+	double n2[3];
+	Normal(positions, first, n1);
+	Normal(positions, second, n2);
+	double dot = n1[0] * n2[0] + n1[1] * n2[1] + n1[2] * n2[2];
+	double length1 = n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2];
+	double length2 = n2[0] * n2[0] + n2[1] * n2[1] + n2[2] * n2[2];
+	if (length1 == 0.0 || length2 == 0.0 || dot <= 0.0 || dot * dot < QUAD_MIN_COS * QUAD_MIN_COS * length1 * length2)
+		return 0;
+	return IsFlat(first) && IsFlat(second) && memcmp(CornerRGB(first, 0), CornerRGB(second, 0), 3) == 0 ? 2 : 1;
+}
+
+static char* PutHeader(char* p, unsigned int mode)
+{
+	PutUInt32(p, mode);
+	return p + 4;
+}
+
+static char* PutColor(char* p, const unsigned char* rgb, unsigned char last)
+{
+	p[0] = (char)rgb[0];
+	p[1] = (char)rgb[1];
+	p[2] = (char)rgb[2];
+	p[3] = (char)last;
+	return p + 4;
+}
+
+int EncodePrimitives(const short* positions, int vertexCount, const std::vector<TMD_3_NS_GP>& polygons, std::vector<char>& block, primitiveStats& stats)
+{
+	int count = (int)polygons.size();
+	stats = primitiveStats();
+	stats.bytesBefore = count * 24;
+
+	//directed edge -> polygon, polygon on the other side of a->b has b->a
+	std::unordered_map<unsigned int, int> edges;
+	edges.reserve(count * 3);
+	std::vector<char> bValid(count);
+	for (int i = 0; i < count; i++)
+	{
+		const TMD_3_NS_GP& poly = polygons[i];
+		bValid[i] = poly.A < vertexCount && poly.B < vertexCount && poly.C < vertexCount;
+		if (!bValid[i])
+			continue;
+		for (int k = 0; k < 3; k++)
+			edges.emplace(((unsigned int)CornerIndex(poly, k) << 16) | CornerIndex(poly, (k + 1) % 3), i);
+	}
+
+	//greedy pairing in polygon order, flat quads are preferred as they are the smallest
+	std::vector<int> partner(count, -1);
+	std::vector<char> sharedCorner(count, 0);
+	std::vector<char> kind(count, 0);
+	for (int i = 0; i < count; i++)
+	{
+		if (!bValid[i] || partner[i] != -1)
+			continue;
+		int bestKind = 0;
+		for (int k = 0; k < 3 && bestKind < 2; k++)
+		{
+			auto other = edges.find(((unsigned int)CornerIndex(polygons[i], (k + 1) % 3) << 16) | CornerIndex(polygons[i], k));
+			if (other == edges.end() || other->second == i || partner[other->second] != -1)
+				continue;
+			int quadKind = QuadKind(positions, polygons[i], k, polygons[other->second]);
+			if (quadKind > bestKind)
+			{
+				bestKind = quadKind;
+				partner[i] = other->second;
+				sharedCorner[i] = (char)k;
+			}
+		}
+		if (partner[i] != -1)
+		{
+			partner[partner[i]] = i;
+			kind[i] = (char)bestKind;
+		}
+	}
+
+	block.clear();
+	block.reserve(count * 24);
+	int written = 0;
+	for (int i = 0; i < count; i++)
+	{
+		const TMD_3_NS_GP& poly = polygons[i];
+		char record[28];
+		char* p = record;
+		if (partner[i] == -1)
+		{
+			if (IsFlat(poly))
+			{
+				p = PutHeader(p, TMD_MODE_3_NS_FP);
+				p = PutColor(p, CornerRGB(poly, 0), 0x21);
+				stats.flatTriangles++;
+			}
+			else
+			{
+				p = PutHeader(p, TMD_MODE_3_NS_GP);
+				p = PutColor(p, CornerRGB(poly, 0), 0x31);
+				p = PutColor(p, CornerRGB(poly, 1), 0);
+				p = PutColor(p, CornerRGB(poly, 2), 0);
+				stats.gouraudTriangles++;
+			}
+			PutUInt16(p, poly.A);
+			PutUInt16(p + 2, poly.B);
+			PutUInt16(p + 4, poly.C);
+			PutUInt16(p + 6, 0);
+			p += 8;
+		}
+		else if (partner[i] > i)
+		{
+			//V0 V1 V2 is this polygon rotated so shared edge is V1 V2, V3 is tip of the partner
+			const TMD_3_NS_GP& other = polygons[partner[i]];
+			int k = sharedCorner[i];
+			int v0 = (k + 2) % 3, v1 = k, v2 = (k + 1) % 3;
+			int d = 3 - FindCorner(other, CornerIndex(poly, v1)) - FindCorner(other, CornerIndex(poly, v2));
+			if (kind[i] == 2)
+			{
+				p = PutHeader(p, TMD_MODE_4_NS_FP);
+				p = PutColor(p, CornerRGB(poly, 0), 0x29);
+				stats.flatQuads++;
+			}
+			else
+			{
+				p = PutHeader(p, TMD_MODE_4_NS_GP);
+				p = PutColor(p, CornerRGB(poly, v0), 0x39);
+				p = PutColor(p, CornerRGB(poly, v1), 0);
+				p = PutColor(p, CornerRGB(poly, v2), 0);
+				p = PutColor(p, CornerRGB(other, d), 0);
+				stats.gouraudQuads++;
+			}
+			PutUInt16(p, CornerIndex(poly, v0));
+			PutUInt16(p + 2, CornerIndex(poly, v1));
+			PutUInt16(p + 4, CornerIndex(poly, v2));
+			PutUInt16(p + 6, CornerIndex(other, d));
+			p += 8;
+		}
+		else
+			continue; //written together with its partner
+		block.insert(block.end(), record, p);
+		written++;
+	}
+	stats.bytesAfter = (int)block.size();
+	return written;
+}
+
+std::string DescribePrimitiveStats(int objectIndex, const primitiveStats& stats)
+{
+	char localn[256];
+	std::snprintf(localn, 256, "Object %d- primitives %d -> %d bytes: %d F3, %d G3, %d F4, %d G4\n", objectIndex,
+		stats.bytesBefore, stats.bytesAfter, stats.flatTriangles, stats.gouraudTriangles, stats.flatQuads, stats.gouraudQuads);
+	return std::string(localn);
+}
+
+static FILE* OpenOutput(const std::string& path)
+{
+	FILE* file = nullptr;
+#ifdef _MSC_VER
+	if (fopen_s(&file, path.c_str(), "wb") != 0)
+		return nullptr;
+#else
+	file = fopen(path.c_str(), "wb");
+#endif
+	return file;
+}
+
+//ranges below this go through stdio buffer- flush and copy call cost more than copying few bytes
+static const int CLONE_MIN_BYTES = 64 * 1024;
+
+//appends count bytes of source file starting at offset to out. On Linux the kernel clones big ranges
+//with copy_file_range (reflink on btrfs/xfs) so they never pass through memory, elsewhere- or when
+//the filesystem refuses- they are written straight from the mapping
+static bool CopyRange(FILE* out, const BinaryReader& source, int sourceFd, int offset, int count)
+{
+	if (count == 0)
+		return true;
+#ifdef __linux__
+	if (sourceFd != -1 && count >= CLONE_MIN_BYTES && fflush(out) == 0)
+	{
+		loff_t from = offset;
+		int left = count;
+		while (left > 0)
+		{
+			ssize_t copied = copy_file_range(sourceFd, &from, fileno(out), NULL, left, 0);
+			if (copied <= 0)
+				break;
+			left -= (int)copied;
+		}
+		fseek(out, 0, SEEK_END); //resync stream with descriptor position
+		if (left == 0)
+			return true;
+		offset += count - left;
+		count = left;
+	}
+#else
+	(void)sourceFd;
+#endif
+	const unsigned char* span = source.GetSpan(offset, count);
+	return span != nullptr && fwrite(span, 1, count, out) == (size_t)count;
+}
+
+//temp file next to path, unique per save so concurrent saves to the same target don't write into each other
+static std::string TempPath(const std::string& path)
+{
+	static std::atomic<unsigned int> saveCounter(0);
+#ifdef _WIN32
+	unsigned long processId = GetCurrentProcessId();
+#else
+	unsigned long processId = (unsigned long)getpid();
+#endif
+	return path + "." + std::to_string(processId) + "-" + std::to_string(saveCounter++) + ".saving";
+}
+
+//flushes temp file to disk and puts it in place of path in one step
+static bool CommitTempFile(FILE* temp, const std::string& tempPath, const std::string& path)
+{
+	bool bFlushed = fflush(temp) == 0;
+#ifdef _WIN32
+	bFlushed = bFlushed && _commit(_fileno(temp)) == 0;
+#else
+	bFlushed = bFlushed && fsync(fileno(temp)) == 0;
+#endif
+	bool bClosed = fclose(temp) == 0;
+	if (!bFlushed || !bClosed)
+		return false;
+#ifdef _WIN32
+	return MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+}
+
+//vertices of unedited object back as XYZW shorts. They were decoded as short / 100.0f so rounding
+//brings back exact value
+static void ObjectPositions(const tmdObject& object, std::vector<short>& positions)
+{
+	positions.resize(object.vertices.size() * 4);
+	const float* xyzw = (const float*)object.vertices.data();
+	for (size_t i = 0; i < positions.size(); i++)
+		positions[i] = (short)lrintf(xyzw[i] * 100.0f);
+}
+
+static bool CanOptimize(const tmdObject& object)
+{
+	if (!CountUnknownModes(object).empty())
+		return false; //sizes of unknown records aren't known to encoder
+	for (const TMD_3_NS_GP& poly : object.polygon)
+		if (poly.A >= object.vertices.size() || poly.B >= object.vertices.size() || poly.C >= object.vertices.size())
+			return false;
+	return true;
+}
+
+static bool WritePositions(FILE* out, const std::vector<short>& positions)
+{
+	std::vector<char> bytes(positions.size() * 2);
+	for (size_t i = 0; i < positions.size(); i++)
+		PutUInt16(&bytes[i * 2], (unsigned short)positions[i]);
+	return fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+}
+
+//how object body gets into the new file
+struct objectPlan
+{
+	bool bClone; //whole body is one contiguous range of source
+	bool bEncodePrims; //primitives go through EncodePrimitives, otherwise copied from source
+	int nVerts;
+	int nNorms;
+	int nPrims;
+	int primBlockSize;
+	std::vector<char> encodedPrims; //of optimized unedited objects, kept from measuring for writing
+};
+
+bool SaveTmd(const Tmd& tmd, BinaryReader& source, int editedObject, const float* corners, int cornerCount, int weldDistance,
+	bool bOptimizeAll, const std::string& path, std::vector<primitiveStats>& stats, std::vector<tmdError>& errors)
+{
+	errors.clear();
+	const unsigned char* fileHeader = source.GetSpan(0, 12);
+	if (fileHeader == nullptr)
+		return false;
+	std::vector<short> editedPositions;
+	std::vector<TMD_3_NS_GP> editedPolygons;
+	if (editedObject >= 0 && editedObject < tmd.objectCount
+		&& !BuildCornerObject(corners, cornerCount, weldDistance, editedPositions, editedPolygons))
+		return false;
+
+	//1. decide how every object is written and lay bodies out one after another behind the object table.
+	//Blocks of unedited objects are only measured- records walked by ilen- unless bOptimizeAll has to
+	//decode them to pack their primitives
+	stats.assign(tmd.objectCount, primitiveStats());
+	std::vector<objectPlan> plans(tmd.objectCount);
+	std::vector<char> table(12 + tmd.objectCount * 28);
+	std::vector<char> editedPrims;
+	std::vector<short> positions;
+	tmdObject scratch; //bodies the cache doesn't hold are decoded here one at a time for bOptimizeAll
+	memcpy(table.data(), fileHeader, 8); //version and flags stay as they were
+	PutUInt32(&table[8], tmd.objectCount);
+	unsigned int offset = (unsigned int)table.size();
+	for (int i = 0; i < tmd.objectCount; i++)
+	{
+		const tmdObject& object = tmd.objects[i];
+		objectPlan& plan = plans[i];
+		MeasureObject(source, object, plan.nVerts, plan.primBlockSize);
+		bool bPrimsWalked = object.nPrims == 0 || plan.primBlockSize != 0;
+		plan.nNorms = source.GetSpan(object.pNorms + 12, object.nNorms * 8) != nullptr ? object.nNorms : 0;
+		//blocks outside of file would be written empty- refused below instead
+		if (i != editedObject && plan.nVerts != object.nVerts)
+			errors.push_back({ TMD_TRUNCATED, TMD_BLOCK_VERTICES, i, object.pVerts + 12 });
+		if (i != editedObject && !bPrimsWalked)
+			errors.push_back({ TMD_TRUNCATED, TMD_BLOCK_PRIMITIVES, i, object.pPrims + 12 });
+		if (plan.nNorms != object.nNorms)
+			errors.push_back({ TMD_TRUNCATED, TMD_BLOCK_NORMALS, i, object.pNorms + 12 });
+		if (!errors.empty())
+			continue;
+		plan.nPrims = bPrimsWalked ? object.nPrims : 0;
+		plan.bEncodePrims = i == editedObject;
+		stats[i].bytesBefore = stats[i].bytesAfter = plan.primBlockSize;
+		if (bOptimizeAll && i != editedObject && bPrimsWalked)
+		{
+			const tmdObject& decoded = DecodedObject(source, object, scratch);
+			if (CanOptimize(decoded))
+			{
+				plan.bEncodePrims = true;
+				ObjectPositions(decoded, positions);
+				plan.nPrims = EncodePrimitives(positions.data(), plan.nVerts, decoded.polygon, plan.encodedPrims, stats[i]);
+				stats[i].bytesBefore = plan.primBlockSize;
+				plan.primBlockSize = (int)plan.encodedPrims.size();
+			}
+		}
+		plan.bClone = !plan.bEncodePrims && bPrimsWalked && plan.nVerts == object.nVerts
+			&& object.pNorms == object.pVerts + plan.nVerts * 8 && object.pPrims == object.pNorms + plan.nNorms * 8;
+		if (i == editedObject)
+		{
+			plan.nVerts = (int)editedPositions.size() / 4;
+			plan.nPrims = EncodePrimitives(editedPositions.data(), plan.nVerts, editedPolygons, editedPrims, stats[i]);
+			plan.primBlockSize = (int)editedPrims.size();
+		}
+		char* entry = &table[12 + i * 28];
+		PutUInt32(entry, offset - 12); //pointers are relative to end of file header
+		PutUInt32(entry + 4, plan.nVerts);
+		PutUInt32(entry + 8, offset + plan.nVerts * 8 - 12);
+		PutUInt32(entry + 12, plan.nNorms);
+		PutUInt32(entry + 16, offset + plan.nVerts * 8 + plan.nNorms * 8 - 12);
+		PutUInt32(entry + 20, plan.nPrims);
+		PutUInt32(entry + 24, object.scale);
+		offset += plan.nVerts * 8 + plan.nNorms * 8 + plan.primBlockSize;
+	}
+	if (!errors.empty())
+		return false;
+
+	//2. write everything to temp file next to target- source may be the very file being replaced
+	//and has to stay readable until the new one is complete
+	std::string tempPath = TempPath(path);
+	FILE* fdout = OpenOutput(tempPath);
+	if (fdout == nullptr)
+		return false;
+	//descriptor the mapping was made from- opening path again could give a file that replaced it since
+	int sourceFd = source.GetDescriptor();
+	bool bOk = fwrite(table.data(), 1, table.size(), fdout) == table.size();
+
+	//3. stream bodies- nothing is decoded here. Untouched objects stored contiguously in source are copied
+	//as one range, blocks of others one by one- unedited vertices are the same bytes as in source
+	for (int i = 0; i < tmd.objectCount && bOk; i++)
+	{
+		const objectPlan& plan = plans[i];
+		const tmdObject& object = tmd.objects[i];
+		if (plan.bClone)
+		{
+			//neighbours that follow each other in source too are one copy- archives of many small objects
+			//would otherwise pay a copy call per object
+			int rangeEnd = object.pVerts + plan.nVerts * 8 + plan.nNorms * 8 + plan.primBlockSize;
+			while (i + 1 < tmd.objectCount && plans[i + 1].bClone && tmd.objects[i + 1].pVerts == rangeEnd)
+			{
+				i++;
+				rangeEnd += plans[i].nVerts * 8 + plans[i].nNorms * 8 + plans[i].primBlockSize;
+			}
+			bOk = CopyRange(fdout, source, sourceFd, object.pVerts + 12, rangeEnd - object.pVerts);
+			continue;
+		}
+		if (i == editedObject)
+			bOk = WritePositions(fdout, editedPositions);
+		else
+			bOk = CopyRange(fdout, source, sourceFd, object.pVerts + 12, plan.nVerts * 8);
+		bOk = bOk && CopyRange(fdout, source, sourceFd, object.pNorms + 12, plan.nNorms * 8);
+		if (!bOk)
+			break;
+		const std::vector<char>& encoded = i == editedObject ? editedPrims : plan.encodedPrims;
+		if (plan.bEncodePrims)
+			bOk = fwrite(encoded.data(), 1, encoded.size(), fdout) == encoded.size();
+		else
+			bOk = CopyRange(fdout, source, sourceFd, object.pPrims + 12, plan.primBlockSize);
+	}
+	if (!bOk)
+	{
+		fclose(fdout);
+		remove(tempPath.c_str());
+		return false;
+	}
+
+	//4. mapping keeps source open (and locked on Windows)- release it for the rename and map the new file
+	bool bReplacesSource = source.IsSameFile(path);
+	std::string sourcePath = source.GetPath();
+	if (bReplacesSource)
+		source = BinaryReader();
+	bOk = CommitTempFile(fdout, tempPath, path);
+	if (!bOk)
+		remove(tempPath.c_str());
+	if (bReplacesSource)
+		source = BinaryReader(sourcePath);
+	return bOk;
+}
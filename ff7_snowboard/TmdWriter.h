@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Tmd.h"
+
+class BinaryReader;
+
+//primitive block written by EncodePrimitives
+struct primitiveStats
+{
+	int bytesBefore; //same polygons as 3 vertex gouraud triangles, or block in source for unedited objects
+	int bytesAfter;
+	int flatTriangles;
+	int gouraudTriangles;
+	int flatQuads;
+	int gouraudQuads;
+};
+
+//welds de-indexed XYZRGB corners (6 floats each, 3 per polygon) into TMD vertices- positions gets XYZW
+//shorts per vertex- and gouraud triangles indexing them. Corners closer than weldDistance TMD units share
+//one vertex (see WeldPositions). Returns false if more than 65536 vertices are left- USHORT indices of
+//polygons can't address them
+bool BuildCornerObject(const float* corners, int cornerCount, int weldDistance, std::vector<short>& positions, std::vector<TMD_3_NS_GP>& polygons);
+
+//packs gouraud triangles into the smallest TMD primitives- flat when all corners share color, 4 vertex
+//polygon when two triangles share an edge, lie in one plane and agree on colors of shared corners.
+//positions are XYZW shorts of vertexCount vertices. Returns number of primitives in block
+int EncodePrimitives(const short* positions, int vertexCount, const std::vector<TMD_3_NS_GP>& polygons, std::vector<char>& block, primitiveStats& stats);
+
+//one line report of primitiveStats
+std::string DescribePrimitiveStats(int objectIndex, const primitiveStats& stats);
+
+//writes whole TMD compacted- header, object table and every object body packed one after another, so no
+//dead bytes are left behind. Object editedObject (-1 for none) is replaced by given corners welded with
+//weldDistance and packed by EncodePrimitives. With bOptimizeAll primitives of every other object are packed
+//too (objects with unknown primitives are left alone), otherwise they are copied. stats gets one entry per object.
+//Normal blocks aren't decoded into Tmd and are copied from source. Objects whose bodies aren't decoded
+//(see ObjectCache) are decoded from source one at a time.
+//Nothing is written if any block but those of editedObject is outside of source- errors gets one entry per
+//such block, as the object would lose its geometry otherwise. Normals of editedObject are checked too.
+//File is written next to path and renamed over it, so path may be the file source has opened- in
+//that case source is reopened on the new file and tmd has to be parsed again as block pointers moved
+bool SaveTmd(const Tmd& tmd, BinaryReader& source, int editedObject, const float* corners, int cornerCount, int weldDistance,
+	bool bOptimizeAll, const std::string& path, std::vector<primitiveStats>& stats, std::vector<tmdError>& errors);
@@ -0,0 +1,41 @@
+#include "VertexArena.h"
+
+VertexArena::VertexArena(size_t maxFloats) : maxFloats(maxFloats)
+{
+	;
+}
+
+bool VertexArena::Reserve(size_t count)
+{
+	if (count > maxFloats)
+		return false;
+	if (count <= storage.size())
+		return true;
+	size_t grown = storage.size() * 2;
+	if (grown < count)
+		grown = count;
+	if (grown > maxFloats)
+		grown = maxFloats;
+	storage.resize(grown);
+	return true;
+}
+
+size_t VertexArena::capacity() const
+{
+	return storage.size();
+}
+
+size_t VertexArena::maxSize() const
+{
+	return maxFloats;
+}
+
+float* VertexArena::data()
+{
+	return storage.data();
+}
+
+float& VertexArena::operator[](size_t i)
+{
+	return storage[i];
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+//Growable float storage for the model being edited. Memory is kept between models so switching
+//objects reuses the block that is already there and only a bigger model grows it.
+//Growth is capped- Reserve refuses anything above maxFloats instead of writing past the end
+class VertexArena
+{
+public:
+	VertexArena(size_t maxFloats);
+	//makes room for count floats, returns false if count is over the cap
+	bool Reserve(size_t count);
+	size_t capacity() const;
+	size_t maxSize() const;
+	float* data();
+	float& operator[](size_t i);
+
+private:
+	std::vector<float> storage;
+	size_t maxFloats;
+};
@@ -0,0 +1,78 @@
+#include "VertexWeld.h"
+#include <unordered_map>
+#include <cstdlib>
+
+//cell coordinates of shorts fit in 17 bits, three of them make the key
+static unsigned long long CellKey(int cx, int cy, int cz)
+{
+	return ((unsigned long long)(cx + 0x10000) << 34) | ((unsigned long long)(cy + 0x10000) << 17) | (unsigned long long)(cz + 0x10000);
+}
+
+//floor division so negative coordinates don't share cell 0 with positive ones
+static int CellOf(int value, int cellSize)
+{
+	return value >= 0 ? value / cellSize : -((-value + cellSize - 1) / cellSize);
+}
+
+void WeldPositions(const short* positions, int count, int distance, std::vector<int>& remap, std::vector<int>& welded)
+{
+	remap.assign(count, -1);
+	welded.clear();
+	if (distance < 0)
+		distance = 0;
+	if (distance > 0xFFFF) //any two shorts are this close
+		distance = 0xFFFF;
+	//cells twice the distance wide- a vertex within distance lies in own cell or in the neighbour
+	//towards which p is close to the cell border, so at most 8 cells are searched
+	int cellSize = 2 * (distance + 1);
+
+	//cell -> last welded vertex put in it, older ones are chained through nextInCell
+	std::unordered_map<unsigned long long, int> cells;
+	cells.reserve(count);
+	std::vector<int> nextInCell;
+	nextInCell.reserve(count);
+
+	for (int i = 0; i < count; i++)
+	{
+		const short* p = positions + i * 3;
+		int cell[3];
+		int side[3];
+		for (int k = 0; k < 3; k++)
+		{
+			cell[k] = CellOf(p[k], cellSize);
+			side[k] = p[k] - cell[k] * cellSize < cellSize / 2 ? -1 : 1;
+			if (distance == 0)
+				side[k] = 0; //identical positions always share the cell
+		}
+		int match = -1;
+		for (int n = 0; n < 8 && match == -1; n++)
+		{
+			int dx = n & 1 ? side[0] : 0;
+			int dy = n & 2 ? side[1] : 0;
+			int dz = n & 4 ? side[2] : 0;
+			if (n != 0 && dx == 0 && dy == 0 && dz == 0)
+				break;
+			auto found = cells.find(CellKey(cell[0] + dx, cell[1] + dy, cell[2] + dz));
+			if (found == cells.end())
+				continue;
+			for (int w = found->second; w != -1; w = nextInCell[w])
+			{
+				const short* q = positions + welded[w] * 3;
+				if (abs(p[0] - q[0]) <= distance && abs(p[1] - q[1]) <= distance && abs(p[2] - q[2]) <= distance)
+				{
+					match = w;
+					break;
+				}
+			}
+		}
+		if (match == -1)
+		{
+			match = (int)welded.size();
+			welded.push_back(i);
+			auto home = cells.emplace(CellKey(cell[0], cell[1], cell[2]), -1).first;
+			nextInCell.push_back(home->second);
+			home->second = match;
+		}
+		remap[i] = match;
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <vector>
+
+//Merges vertices whose positions differ by at most distance on every axis. Positions are packed XYZ
+//shorts (TMD units), distance 0 merges only identical positions. Uses hash grid so every vertex looks
+//only at a few cells around it- expected O(n).
+//remap gets index of welded vertex for every input vertex, welded keeps indices of kept input vertices
+//in order they were first seen (welded vertex takes position of the first vertex merged into it)
+void WeldPositions(const short* positions, int count, int distance, std::vector<int>& remap, std::vector<int>& welded);
@@ -16,7 +16,19 @@
 #include <commdlg.h>
 #include <string>
 #include "BinaryReader.h"
+#include "Tmd.h"
+#include "TmdExport.h"
+#include "IndexedMesh.h"
+#include "VertexArena.h"
+#include "TmdWriter.h"
+#include "SceneImport.h"
+#include "ImportJob.h"
+#include "ObjectCache.h"
+#include "LoadJob.h"
+#include "GpuMeshCache.h"
+#include "SceneView.h"
 #include <vector>
+#include <climits>
 
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
@@ -49,7 +61,6 @@ float fov = 45.0f;
 float deltaTime = 0.0f;	// time between current frame and last frame
 float lastFrame = 0.0f;
 
-unsigned int VAO, VBO, EBO;
 std::string sVerticesCount;
 std::string sPolyCount;
 std::string sModelId;
@@ -78,12 +89,27 @@ const char* fragmentShaderSource = "#version 330 core\n"
 void ImguiMenu();
 std::string OpenFileDialog(const char* filter, const char* lpstr);
 std::string OpenSaveDialog(const char* filter, const char* lpstr);
-void ParseTmd();
 void OpenRenderModel(int i);
 void DrawModel();
+void DrawScene(const glm::mat4& projView);
+void FinishImport();
+void FinishLoad();
 static BinaryReader br;
+static Assimp::Importer importer; //kept for whole session so importers and their settings are set up once
+static ImportJob importJob(importer); //imports run on its thread, result is swapped in by FinishImport
+static LoadJob loadJob; //files are opened on its thread, result is swapped in by FinishLoad
+static int meshBudgetMB = 128;
+static GpuMeshCache meshCache((size_t)meshBudgetMB * 1024 * 1024); //meshes of recently shown objects stay on GPU
+static bool bSceneView = false; //every object at once instead of modelId
+static SceneView sceneView; //built when scene view is turned on, released when file changes
+static int importPresetIndex = 1; //into IMPORT_PRESETS
+static std::vector<importReport> importReports(IMPORT_PRESET_COUNT); //last import with every preset
 
 static int modelId = -1;
+static int weldDistance = 0; //corners closer than this (TMD units) share vertex when compiling
+static int importPolygonBudget = 0; //imported models are decimated to this many polygons, 0 keeps all
+static bool bOptimizeAllObjects = false; //pack primitives of every object on compile, not only the edited one
+std::string sSaveReport; //bytes saved by primitive packing on last compile
 
 bool bShowMainMenu = false;
 bool bIsCustomModel = false;
@@ -187,6 +213,7 @@ int main(int argc, char** argv)
 	ImGui_ImplOpenGL3_Init(glsl_version);
 
 	glEnable(GL_DEPTH_TEST);
+	SetupImporter(importer);
 
 
 
@@ -251,7 +278,12 @@ int main(int argc, char** argv)
 		glClearColor(0.2f, 0.2f, 0.2f, 1.f);
 
 		glUseProgram(shaderProgram);
-		DrawModel();
+		FinishLoad();
+		FinishImport();
+		if (bSceneView)
+			DrawScene(projection * view);
+		else
+			DrawModel();
 
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
@@ -265,84 +297,208 @@ int main(int argc, char** argv)
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
+	meshCache.Invalidate(NULL); //GL objects go while context is still there
+	sceneView.Release();
 	return 0;
 }
 
 
-struct TMD_3_NS_GP
+Tmd currentTmd;
+static int decodeBudgetMB = 256;
+static ObjectCache objectCache((size_t)decodeBudgetMB * 1024 * 1024); //object bodies of currentTmd are decoded when opened
+int verticesIndex = 0;
+//de-indexed XYZRGB corners of shown model- 6 floats per corner, 3 corners per polygon.
+//Capped at 4M corners (~96MB) so broken or huge imports are refused
+VertexArena vertices(4 * 1024 * 1024 * 6);
+
+
+gpuMesh* currentMesh = NULL; //shown object in meshCache
+
+//VBO keeps whatever was uploaded last- only changed vertices are sent again.
+//bVertexBufferStale forces full upload (new model), dirty range covers edited pigments
+bool bVertexBufferStale = false;
+int dirtyFirstVertex = INT_MAX;
+int dirtyLastVertex = -1;
+
+//shown mesh no longer matches its object in file, so it won't be picked up again when object is reopened
+void MarkModelEdited()
 {
-	unsigned int MODE;
-	unsigned char R0, G0, B0, mode2, R1, G1, B1, pad1, R2, G2, B2, pad2;
-	unsigned short A, B, C, pad;
-};
+	if (currentMesh != NULL)
+		currentMesh->version++;
+}
 
-struct vertex
+void MarkVerticesDirty(int firstVertex, int count)
 {
-	float x;
-	float y;
-	float z;
-	float w;
-};
+	MarkModelEdited();
+	if (firstVertex < dirtyFirstVertex)
+		dirtyFirstVertex = firstVertex;
+	if (firstVertex + count - 1 > dirtyLastVertex)
+		dirtyLastVertex = firstVertex + count - 1;
+}
+
+//indexed path is used only for TMD objects- imported models have no shared positions to index
+bool bIndexedRendering = true;
+std::string sRenderStats;
 
-struct tmdObject
+bool IsIndexedDraw()
 {
-	int pVerts;
-	int nVerts;
-	int pNorms;
-	int nNorms;
-	int pPrims;
-	int nPrims;
-	int scale;
-	std::vector<vertex> vertices;
-	std::vector<TMD_3_NS_GP> polygon;
-};
-
-struct Tmd
+	return bIndexedRendering && !bIsCustomModel;
+}
+
+void UpdateRenderStats()
 {
-	int objectCount;
-	std::vector<tmdObject> objects;
-};
+	int triangleVerts = verticesIndex / 6;
+	int indexedVerts = currentMesh->indexedVertexCount;
+	int indexedBytes = (int)(indexedVerts * 6 * sizeof(float) + currentMesh->indexCount * sizeof(unsigned int));
+	char localn[256];
+	std::snprintf(localn, 256, "Triangles: %d verts, %.1f KB\nIndexed: %d verts, %.1f KB",
+		triangleVerts, triangleVerts * 6 * sizeof(float) / 1024.0f, indexedVerts, indexedBytes / 1024.0f);
+	sRenderStats = localn;
+}
 
-Tmd currentTmd;
-int verticesIndex = 0;
-int indices[1024] = { 0 };
-float vertices[1024*1024] = { 0 };
+//full upload of current model into its VBO (and EBO for indexed path). VAO has to be bound
+void UploadRenderModel()
+{
+	indexedMesh mesh;
+	if (!bIsCustomModel)
+	{
+		BuildIndexedMesh(currentTmd.objects[modelId], &vertices[3], 6, mesh);
+		currentMesh->indexedVertexCount = (int)mesh.vertices.size() / 6;
+		currentMesh->indexCount = (int)mesh.indices.size();
+		UpdateRenderStats();
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, currentMesh->vbo);
+	currentMesh->bIndexed = IsIndexedDraw();
+	if (currentMesh->bIndexed)
+	{
+		glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+		currentMesh->drawCount = (int)mesh.indices.size();
+		currentMesh->bytes = mesh.vertices.size() * sizeof(float) + mesh.indices.size() * sizeof(unsigned int);
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, verticesIndex * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, NULL, GL_STATIC_DRAW);
+		currentMesh->drawCount = verticesIndex / 6;
+		currentMesh->bytes = verticesIndex * sizeof(float);
+	}
+	meshCache.Trim();
+	bVertexBufferStale = false;
+	dirtyFirstVertex = INT_MAX;
+	dirtyLastVertex = -1;
+}
 
+void UploadVertexBuffer()
+{
+	//pigment edit may split or merge indexed vertices, so indexed mesh is simply rebuilt
+	if (bVertexBufferStale || (IsIndexedDraw() && dirtyLastVertex >= dirtyFirstVertex))
+		UploadRenderModel();
+	else if (dirtyLastVertex >= dirtyFirstVertex)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, currentMesh->vbo);
+		glBufferSubData(GL_ARRAY_BUFFER, dirtyFirstVertex * 6 * sizeof(float),
+			(dirtyLastVertex - dirtyFirstVertex + 1) * 6 * sizeof(float), &vertices[dirtyFirstVertex * 6]);
+	}
+	dirtyFirstVertex = INT_MAX;
+	dirtyLastVertex = -1;
+}
 
 void DrawModel()
 {
 	if (modelId == -1)
 		return;
-	glBindVertexArray(VAO);
-	glBufferData(GL_ARRAY_BUFFER, verticesIndex * 6, vertices, GL_STATIC_DRAW);
-	if (!bIsCustomModel)
-		glDrawArrays(GL_TRIANGLES, 0, currentTmd.objects[modelId].nPrims * 3);
+	glBindVertexArray(currentMesh->vao);
+	UploadVertexBuffer();
+	if (currentMesh->bIndexed)
+		glDrawElements(GL_TRIANGLES, currentMesh->drawCount, GL_UNSIGNED_INT, (void*)0);
 	else
-		glDrawArrays(GL_TRIANGLES, 0, verticesIndex / 6);
+		glDrawArrays(GL_TRIANGLES, 0, currentMesh->drawCount);
 	glBindVertexArray(0);
 }
 
+void DrawScene(const glm::mat4& projView)
+{
+	if (!sceneView.IsBuilt())
+	{
+		if (!br.bIsOpened)
+			return;
+		if (!sceneView.Build(currentTmd, br))
+		{
+			bSceneView = false;
+			MessageBox(NULL, "File has no objects the viewer can show!", "ERROR", MB_OK);
+			return;
+		}
+	}
+	sceneView.Draw(projView);
+}
+
 
 
+void CloseRenderModel()
+{
+	if (modelId == -1)
+		return;
+	//file version stays in meshCache for reopening, edited one would only hold budget until it's trimmed
+	if (currentMesh != NULL && currentMesh->version != 0)
+		meshCache.Remove(currentMesh);
+	currentMesh = NULL;
+	modelId = -1;
+	bIsCustomModel = false;
+	verticesIndex = 0;
+}
+
 void OpenRenderModel(int i)
 {
-	if (modelId != -1)
+	std::vector<tmdError> errors;
+	if (!objectCache.Acquire(currentTmd, br, i, errors))
+	{
+		std::string message = "Object blocks point outside of file!";
+		for (const tmdError& error : errors)
+			message += "\n" + DescribeTmdError(error);
+		MessageBox(NULL, message.c_str(), "ERROR", MB_OK);
+		if (modelId != -1)
+			objectCache.Acquire(currentTmd, br, modelId, errors); //shown object has to stay most recent so it isn't freed
+		return;
+	}
+	//checked before anything is closed- failed Reserve leaves vertices[] as it was, so shown object stays
+	//as it is and cached body isn't touched
+	if (!vertices.Reserve(currentTmd.objects[i].polygon.size() * 18))
 	{
-		glDeleteVertexArrays(1, &VAO);
-		glDeleteBuffers(1, &VBO);
+		MessageBox(NULL, "Model is too big to be shown!", "ERROR", MB_OK);
+		if (modelId != -1)
+			objectCache.Acquire(currentTmd, br, modelId, errors);
+		return;
 	}
+	std::string unknownModes = DescribeUnknownModes(i, currentTmd.objects[i]);
+	if (!unknownModes.empty())
+		OutputDebugString(unknownModes.c_str());
+	CloseRenderModel();
+	importJob.Cancel(); //it was meant for previous object
 	bIsCustomModel = false;
 	modelId = i;
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
 	verticesIndex = 0;
 
-	for (int i = 0; i < currentTmd.objects[modelId].nPrims; i++)
+	const int nVerts = (int)currentTmd.objects[modelId].vertices.size();
+	for (int i = 0; i < (int)currentTmd.objects[modelId].polygon.size(); i++)
 	{
+		const TMD_3_NS_GP& poly = currentTmd.objects[modelId].polygon[i];
+		if (poly.A >= nVerts || poly.B >= nVerts || poly.C >= nVerts)
+		{
+			//unknown records keep whatever their bytes hold as indices- corners stay one per polygon, as
+			//pigment editor and indexing pair them by polygon index, but collapse to origin
+			const unsigned char* rgb = &poly.R0;
+			for (int k = 0; k < 3; k++)
+			{
+				vertices[verticesIndex + k * 6] = vertices[verticesIndex + k * 6 + 1] = vertices[verticesIndex + k * 6 + 2] = 0.0f;
+				vertices[verticesIndex + k * 6 + 3] = rgb[k * 4] / 256.0f;
+				vertices[verticesIndex + k * 6 + 4] = rgb[k * 4 + 1] / 256.0f;
+				vertices[verticesIndex + k * 6 + 5] = rgb[k * 4 + 2] / 256.0f;
+			}
+			verticesIndex += 18;
+			continue;
+		}
 		vertices[verticesIndex] = currentTmd.objects[modelId].vertices[currentTmd.objects[modelId].polygon[i].A].x;
 		vertices[verticesIndex +1] = -currentTmd.objects[modelId].vertices[currentTmd.objects[modelId].polygon[i].A].y;
 		vertices[verticesIndex +2] = currentTmd.objects[modelId].vertices[currentTmd.objects[modelId].polygon[i].A].z;
@@ -366,15 +522,24 @@ void OpenRenderModel(int i)
 		verticesIndex += 18;
 	}
 
-	int vertSize = sizeof(currentTmd.objects[modelId].vertices) * currentTmd.objects[modelId].nVerts;
-	//glBufferData(GL_ARRAY_BUFFER, vertSize, &currentTmd.objects[modelId].vertices[0], GL_STATIC_DRAW);
-	glBufferData(GL_ARRAY_BUFFER, verticesIndex*6, vertices, GL_STATIC_DRAW);
-	//position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+	//corners above are still needed by pigment editor and compile, but indexing and upload are skipped
+	//when object was shown before and not edited since
+	currentMesh = meshCache.Find(modelId, 0);
+	dirtyFirstVertex = INT_MAX;
+	dirtyLastVertex = -1;
+	if (currentMesh != NULL && currentMesh->bIndexed == IsIndexedDraw())
+	{
+		bVertexBufferStale = false;
+		UpdateRenderStats();
+	}
+	else
+	{
+		if (currentMesh == NULL)
+			currentMesh = meshCache.Insert(modelId, 0);
+		glBindVertexArray(currentMesh->vao);
+		UploadRenderModel();
+		glBindVertexArray(0);
+	}
 
 	sVerticesCount.clear();
 	char localn[256];
@@ -392,57 +557,92 @@ void OpenRenderModel(int i)
 }
 
 
-void ParseTmd()
+//swaps finished import into vertices[], called every frame on the render thread
+void FinishImport()
 {
-	if (!br.bIsOpened)
+	if (!importJob.IsDone())
+		return;
+	importResult result = importJob.Finish();
+	if (result.bAssimp && result.report.bUsed)
+		importReports[result.preset] = result.report;
+	if (result.bCancelled || modelId == -1)
 		return;
-	UINT tmdVersion = br.ReadUInt32();
-	if (tmdVersion != 0x41)
+	if (result.bTooBig || (result.bSuccess && !vertices.Reserve(result.corners.size())))
 	{
-		MessageBox(NULL, "Invalid FFVIII TMD file!", "ERROR", MB_OK);
+		MessageBox(NULL, "Imported model is too big! Decimate it before importing", "ERROR", MB_OK);
 		return;
 	}
-	br.seek(4, std::ios::cur);
-	currentTmd.objectCount = br.ReadUInt32();
-	currentTmd.objects.resize(currentTmd.objectCount);
-	for (int i = 0; i < currentTmd.objectCount; i++)
+	if (!result.bSuccess)
 	{
-		currentTmd.objects[i].pVerts = br.ReadUInt32();
-		currentTmd.objects[i].nVerts = br.ReadUInt32();
-		currentTmd.objects[i].pNorms = br.ReadUInt32();
-		currentTmd.objects[i].nNorms = br.ReadUInt32();
-		currentTmd.objects[i].pPrims = br.ReadUInt32();
-		currentTmd.objects[i].nPrims = br.ReadUInt32();
-		currentTmd.objects[i].scale = br.ReadUInt32();
-		currentTmd.objects[i].vertices.resize(currentTmd.objects[i].nVerts);
+		MessageBox(NULL, "Couldn't import model!", "ERROR", MB_OK);
+		return;
 	}
-	for(int i = 0; i<currentTmd.objectCount; i++)
+	if (result.bNoColors)
+		MessageBox(NULL, "Imported mesh has no material colors nor normals! You would need to create colors manually", "INFO", MB_OK);
+	memcpy(&vertices[0], result.corners.data(), result.corners.size() * sizeof(float));
+	verticesIndex = (int)result.corners.size();
+	MarkModelEdited();
+	bIsCustomModel = true;
+	bVertexBufferStale = true;
+}
+
+static void ShowTableErrors(TmdStatus status, const std::vector<tmdError>& errors)
+{
+	if (status == TMD_INVALID_VERSION)
+		MessageBox(NULL, "Invalid FFVII TMD file!", "ERROR", MB_OK);
+	else if (status == TMD_TRUNCATED)
 	{
-		for (int k = 0; k < currentTmd.objects[i].nVerts; k++)
-		{
-			br.seek(currentTmd.objects[i].pVerts + k * 8 + 12, std::ios::beg);
-			currentTmd.objects[i].vertices[k].x = br.ReadInt16() / 100.0f;
-			currentTmd.objects[i].vertices[k].y = br.ReadInt16() / 100.0f;
-			currentTmd.objects[i].vertices[k].z = br.ReadInt16() / 100.0f;
-			currentTmd.objects[i].vertices[k].w = br.ReadInt16() / 100.0f;
-		}
-		for (int k = 0; k < currentTmd.objects[i].nPrims; k++)
-		{
-			currentTmd.objects[i].polygon.resize(currentTmd.objects[i].nPrims);
-			br.seek(currentTmd.objects[i].pPrims + k * sizeof(TMD_3_NS_GP) + 12, std::ios::beg);
-			char poly[sizeof(TMD_3_NS_GP)];
-			br.ReadBuffer(poly, sizeof(TMD_3_NS_GP));
-			currentTmd.objects[i].polygon[k] = *(TMD_3_NS_GP*)poly;
-			if (currentTmd.objects[i].polygon[k].MODE != 0x31010506)
-			{
-				char output[256];
-				std::snprintf(output,256, "Object %d- polygon at %d was not 0x06050131!. It was: %08X\n", i, k, currentTmd.objects[i].polygon[k].MODE);
-				OutputDebugString(output);
-			}
-		}
+		std::string message = "TMD file is truncated- object table points outside of file!";
+		for (const tmdError& error : errors)
+			message += "\n" + DescribeTmdError(error);
+		MessageBox(NULL, message.c_str(), "ERROR", MB_OK);
 	}
 }
 
+//swaps file opened by loadJob in, called every frame on the render thread before anything reads br
+void FinishLoad()
+{
+	if (!loadJob.IsDone())
+		return;
+	loadResult result = loadJob.Finish();
+	if (!result.bOpened)
+	{
+		MessageBox(NULL, "Couldn't open file!", "ERROR", MB_OK);
+		return;
+	}
+	importJob.Cancel(); //it was meant for object of previous file
+	CloseRenderModel();
+	meshCache.Invalidate(NULL); //object indices are of the old file
+	sceneView.Release();
+	br = std::move(result.reader);
+	currentTmd = std::move(result.tmd);
+	objectCache.Reset(currentTmd.objectCount);
+	ShowTableErrors(result.status, result.errors);
+	bShowMainMenu = true;
+}
+
+//re-reads object table of br in place- after saving over the opened file
+void ReloadAfterSave()
+{
+	if (!br.bIsOpened)
+		return;
+	//only object table is read here, bodies are decoded by objectCache as objects are opened
+	std::vector<tmdError> errors;
+	TmdStatus status = ParseTmdTable(br, currentTmd, errors);
+	objectCache.Reset(currentTmd.objectCount);
+	//packing pairs triangles into quads, so saved bodies decode in different polygon and corner order than
+	//vertices[] has- shown object is reopened from the new body instead of pairing it with stale corners
+	int shownModel = modelId;
+	CloseRenderModel();
+	meshCache.Invalidate(NULL);
+	sceneView.Release(); //rebuilt from saved bodies on next frame
+	ShowTableErrors(status, errors);
+	if (status == TMD_INVALID_VERSION)
+		return;
+	if (shownModel != -1 && shownModel < currentTmd.objectCount)
+		OpenRenderModel(shownModel);
+}
+
 
 void ImguiMenu()
 {
@@ -464,14 +664,14 @@ void ImguiMenu()
 	ImGui::SetNextWindowPos(ImVec2(0, height / 4));
 	ImGui::SetNextWindowSize(ImVec2(width * 0.25f, height * 0.66f));
 		ImGui::Begin("Main menu", NULL);
-		if (ImGui::Button("OPEN FILE"))
+		if (loadJob.IsRunning())
+			ImGui::ProgressBar(loadJob.Progress(), ImVec2(-1.0f, 0.0f), loadJob.Stage());
+		else if (ImGui::Button("OPEN FILE"))
 		{
 			std::string openedFile = OpenFileDialog("FFVII TMD (.tmd)\0*.TMD\0Any File\0*.*\0", "Select a FFVII snowboard TMD file");
 			if (openedFile == "NULL")
 				goto __imguiEnd;
-			br = BinaryReader(openedFile);
-			ParseTmd();
-			bShowMainMenu = true;
+			loadJob.Start(openedFile); //FinishLoad swaps it in once it's read
 		}
 		if (bShowMainMenu)
 		{
@@ -483,341 +683,129 @@ void ImguiMenu()
 					std::string exportPath = OpenSaveDialog("Wavefront OBJ (.obj)\0*.obj", "Export path as...");
 					if (exportPath != "NULL")
 					{
-						std::ofstream fdout;
-						fdout.open(exportPath, std::ios::out);
-						for (int i = 0; i < currentTmd.objects[modelId].nVerts; i++)
-						{
-							char localn[256];
-							std::snprintf(localn,256, "v %f %f %f\n",
-								(float)((double)currentTmd.objects[modelId].vertices[i].x*100.0f),
-								(float)((double)-currentTmd.objects[modelId].vertices[i].y*100.0f),
-								(float)((double)currentTmd.objects[modelId].vertices[i].z*100.0f)
-								);
-							fdout << localn;
-						}
-						for (int i = 0; i < currentTmd.objects[modelId].nPrims; i++)
-						{
-							char localn[256];
-							std::snprintf(localn, 256, "vn %f %f %f\n",
-								currentTmd.objects[modelId].polygon[i].R0/256.0f,
-								currentTmd.objects[modelId].polygon[i].G0/256.0f,
-								currentTmd.objects[modelId].polygon[i].B0/256.0f
-							);
-							fdout << localn;
-							std::snprintf(localn, 256, "vn %f %f %f\n",
-								currentTmd.objects[modelId].polygon[i].R1 / 256.0f,
-								currentTmd.objects[modelId].polygon[i].G1 / 256.0f,
-								currentTmd.objects[modelId].polygon[i].B1 / 256.0f
-							);
-							fdout << localn;
-							std::snprintf(localn, 256, "vn %f %f %f\n",
-								currentTmd.objects[modelId].polygon[i].R2 / 256.0f,
-								currentTmd.objects[modelId].polygon[i].G2 / 256.0f,
-								currentTmd.objects[modelId].polygon[i].B2 / 256.0f
-							);
-							fdout << localn;
-						}
-						int normalPointer = 1;
-						for (int i = 0; i < currentTmd.objects[modelId].nPrims; i++)
-						{
-							char localn[256];
-							std::snprintf(localn, 256, "f %d//%d %d//%d %d//%d\n",
-								currentTmd.objects[modelId].polygon[i].A+1,
-								normalPointer,
-								currentTmd.objects[modelId].polygon[i].B+1,
-								normalPointer+1,
-								currentTmd.objects[modelId].polygon[i].C+1,
-								normalPointer+2
-							);
-							normalPointer += 3;
-							fdout << localn;
-						}
-						fdout.close();
-						
+						if (!ExportObj(currentTmd.objects[modelId], exportPath))
+							MessageBox(NULL, "Couldn't write exported model!", "ERROR", MB_OK);
 					}
 				}
 				ImGui::SameLine();
-				if (ImGui::Button("Import model"))
+				if (importJob.IsRunning())
+				{
+					ImGui::ProgressBar(importJob.Progress(), ImVec2(-1.0f, 0.0f), importJob.Stage());
+					if (ImGui::Button("Cancel import"))
+						importJob.Cancel();
+				}
+				else if (ImGui::Button("Import model"))
 				{
-					Assimp::Importer importer;
 					std::string importPath = OpenFileDialog(
-						"Wavefront OBJ (.obj)\0*.obj\0Autodesk FBX (.fbx)\0*.fbx\0Any file\0*.*",
-						"Select OBJ model to import");
-					if (!importPath.empty())
-					{
-						const aiScene* impScene = importer.ReadFile(importPath, aiProcess_Triangulate);
-						if (impScene != NULL)
-							if (impScene->HasMeshes())
-							{
-							aiMesh* mesh = impScene->mMeshes[0];
-							if (!mesh->HasNormals())
-								MessageBox(NULL, "Imported mesh has no normals! You would need to create colors manually", "INFO", MB_OK);
-							verticesIndex = 0;
-							for (int i = 0; i < mesh->mNumFaces; i++)
-							{
-								UINT A = mesh->mFaces[i].mIndices[0];
-								UINT B = mesh->mFaces[i].mIndices[1];
-								UINT C = mesh->mFaces[i].mIndices[2];
-
-								vertices[verticesIndex] = mesh->mVertices[A].x/100.0f;
-								vertices[verticesIndex+1] = mesh->mVertices[A].y/100.0f;
-								vertices[verticesIndex+2] = mesh->mVertices[A].z / 100.0f;
-
-								if (mesh->HasNormals())
-								{
-									vertices[verticesIndex + 3] = mesh->mNormals[A].x;
-									vertices[verticesIndex + 4] = mesh->mNormals[A].y;
-									vertices[verticesIndex + 5] = mesh->mNormals[A].z;
-								}
-								else
-								{
-									vertices[verticesIndex + 3] = 0.0f;
-									vertices[verticesIndex + 4] = 0.0f;
-									vertices[verticesIndex + 5] = 0.0f;
-								}
-
-								vertices[verticesIndex+6] = mesh->mVertices[B].x / 100.0f;
-								vertices[verticesIndex + 7] = mesh->mVertices[B].y / 100.0f;
-								vertices[verticesIndex + 8] = mesh->mVertices[B].z / 100.0f;
-
-								if (mesh->HasNormals())
-								{
-									vertices[verticesIndex + 9] = mesh->mNormals[B].x;
-									vertices[verticesIndex + 10] = mesh->mNormals[B].y;
-									vertices[verticesIndex + 11] = mesh->mNormals[B].z;
-								}
-								else
-								{
-									vertices[verticesIndex + 9] = 0.0f;
-									vertices[verticesIndex + 10] = 0.0f;
-									vertices[verticesIndex + 11] = 0.0f;
-								}
-
-								vertices[verticesIndex+12] = mesh->mVertices[C].x / 100.0f;
-								vertices[verticesIndex + 13] = mesh->mVertices[C].y / 100.0f;
-								vertices[verticesIndex + 14] = mesh->mVertices[C].z / 100.0f;
-
-								if (mesh->HasNormals())
-								{
-									vertices[verticesIndex + 15] = mesh->mNormals[C].x;
-									vertices[verticesIndex + 16] = mesh->mNormals[C].y;
-									vertices[verticesIndex + 17] = mesh->mNormals[C].z;
-								}
-								else
-								{
-									vertices[verticesIndex + 15] = 0.0f;
-									vertices[verticesIndex + 16] = 0.0f;
-									vertices[verticesIndex + 17] = 0.0f;
-								}
-								verticesIndex += 18;
-							}
-						}
-						bIsCustomModel = true;
-					}
+						"Wavefront OBJ (.obj)\0*.obj\0Stanford PLY (.ply)\0*.ply\0STL (.stl)\0*.stl\0Autodesk FBX (.fbx)\0*.fbx\0Any file\0*.*",
+						"Select model to import");
+					if (importPath != "NULL")
+						importJob.Start(importPath, importPresetIndex, importPolygonBudget, vertices.maxSize() / 6);
 				}
+				ImGui::Combo("Import preset", &importPresetIndex, [](void*, int idx, const char** out_text)
+				{
+					*out_text = IMPORT_PRESETS[idx].name;
+					return true;
+				}, NULL, IMPORT_PRESET_COUNT);
+				for (int i = 0; i < IMPORT_PRESET_COUNT; i++)
+					if (importReports[i].bUsed)
+						ImGui::Text("%s", DescribeImportReport(i, importReports[i]).c_str());
+				if (ImGui::InputInt("Import polygon budget", &importPolygonBudget) && importPolygonBudget < 0)
+					importPolygonBudget = 0;
+				ImGui::SameLine();
+				if (ImGui::Button("Original"))
+					importPolygonBudget = currentTmd.objects[modelId].nPrims;
+				if (ImGui::InputInt("Weld distance", &weldDistance) && weldDistance < 0)
+					weldDistance = 0;
+				ImGui::Checkbox("Optimize primitives of all objects", &bOptimizeAllObjects);
 				if (ImGui::Button("Compile and save"))
 				{
-					int currentChosen = modelId;
 					std::string compilePath = OpenSaveDialog("Final Fantasy VII TMD file (.tmd)\0*.tmd", "Save FFVII TMD File");
-					br.seek(0, std::ios::beg); //go to beginning and read data until the choosen model
-					std::fstream fdout(compilePath, std::ios::out | std::ios::binary);
-
-					//as there's no way to calculate sizes on invalid meshes I choose to append data at the end of file
-					br.seek(0, std::ios::end);
-					int fileSize = br.tell();
-					char* fileBuffer = (char*)calloc(fileSize, sizeof(char));
-					br.seek(0, std::ios::beg); //rewind;
-					br.ReadBuffer(fileBuffer, fileSize);
-					fdout.write(fileBuffer, fileSize);
-					free(fileBuffer);
-
-
-					int vertPointer = br.tell(); //we at the EOF, get pointer
-					//ok, we now have copy of the file- we now append verts and polys at the end of file
-					int vertCount = verticesIndex / 6; //6 per XYZ RGB
-					int polyCount = verticesIndex / 18; //18 per ABC poly
-					int vertIdx = 0;
-					for (int i = 0; i < vertCount; i++)
-					{
-						float x = vertices[vertIdx] * 100.0f;
-						float y = -vertices[vertIdx + 1] * 100.0f;
-						float z = vertices[vertIdx + 2] * 100.0f;
-						short x_ = x;
-						short y_ = y;
-						short z_ = z;
-
-						vertIdx += 6; //skip RGB
-						fdout.write((char*)&x_, sizeof(short));
-						fdout.write((char*)&y_, sizeof(short));
-						fdout.write((char*)&z_, sizeof(short));
-						fdout.write("\0\0", sizeof(short));
-					}
-					int polyPointer = fdout.tellg();
-					vertIdx = 0;
-					int abcPointer = 0;
-					for (int i = 0; i < polyCount; i++)
+					if (compilePath != "NULL")
 					{
-						float R0_ = abs(vertices[vertIdx+3]) * 255.0f;
-						float G0_ = abs(vertices[vertIdx + 4]) * 255.0f;
-						float B0_ = abs(vertices[vertIdx + 5]) * 255.0f;
-
-						float R1_ = abs(vertices[vertIdx + 9]) * 255.0f;
-						float G1_ = abs(vertices[vertIdx + 10]) * 255.0f;
-						float B1_ = abs(vertices[vertIdx + 11]) * 255.0f;
-
-						float R2_ = abs(vertices[vertIdx + 15]) * 255.0f;
-						float G2_ = abs(vertices[vertIdx + 16]) * 255.0f;
-						float B2_ = abs(vertices[vertIdx + 17]) * 255.0f;
-
-						BYTE R0 = (BYTE)R0_;
-						BYTE G0 = (BYTE)G0_;
-						BYTE B0 = (BYTE)B0_;
-
-						BYTE R1 = (BYTE)R1_;
-						BYTE G1 = (BYTE)G1_;
-						BYTE B1 = (BYTE)B1_;
-
-						BYTE R2 = (BYTE)R2_;
-						BYTE G2 = (BYTE)G2_;
-						BYTE B2 = (BYTE)B2_;
-
-						vertIdx += 18; //advance;
-						fdout.write("\x06\x05\x01\x31", sizeof(DWORD)); //polyHeader;
-						fdout.write((char*)&R0, sizeof(BYTE));
-						fdout.write((char*)&G0, sizeof(BYTE));
-						fdout.write((char*)&B0, sizeof(BYTE));
-						fdout.write("\x31", sizeof(BYTE));
-
-						fdout.write((char*)&R1, sizeof(BYTE));
-						fdout.write((char*)&G1, sizeof(BYTE));
-						fdout.write((char*)&B1, sizeof(BYTE));
-						fdout.write("\x00", sizeof(BYTE));
-
-						fdout.write((char*)&R2, sizeof(BYTE));
-						fdout.write((char*)&G2, sizeof(BYTE));
-						fdout.write((char*)&B2, sizeof(BYTE));
-						fdout.write("\x00", sizeof(BYTE));
-
-						fdout.write((char*)&abcPointer, sizeof(USHORT));
-						abcPointer++;
-						fdout.write((char*)&abcPointer, sizeof(USHORT));
-						abcPointer++;
-						fdout.write((char*)&abcPointer, sizeof(USHORT));
-						abcPointer++;
-						fdout.write("\0\0", sizeof(USHORT));
+						std::vector<primitiveStats> stats;
+						std::vector<tmdError> saveErrors;
+						if (!SaveTmd(currentTmd, br, modelId, &vertices[0], verticesIndex / 6, weldDistance, bOptimizeAllObjects, compilePath, stats, saveErrors))
+						{
+							if (!saveErrors.empty())
+							{
+								std::string message = "Not saved- these objects would lose their geometry:";
+								for (const tmdError& error : saveErrors)
+									message += "\n" + DescribeTmdError(error);
+								MessageBox(NULL, message.c_str(), "ERROR", MB_OK);
+							}
+							else
+								MessageBox(NULL, "Couldn't write compiled TMD file! Object may have more than 65536 vertices- raise weld distance or import with lower polygon budget", "ERROR", MB_OK);
+						}
+						else
+						{
+							long long bytesSaved = 0;
+							sSaveReport.clear();
+							for (int i = 0; i < (int)stats.size(); i++)
+							{
+								if (stats[i].bytesAfter == stats[i].bytesBefore)
+									continue;
+								bytesSaved += stats[i].bytesBefore - stats[i].bytesAfter;
+								sSaveReport += DescribePrimitiveStats(i, stats[i]);
+							}
+							sSaveReport += "Saved " + std::to_string(bytesSaved) + " bytes of primitives";
+							if (br.IsSameFile(compilePath))
+								ReloadAfterSave(); //saved over opened file- br now maps the new layout, so object pointers have to follow
+						}
 					}
-
-					polyPointer -= 12;
-					vertPointer -= 12;
-					//now go back to header and assign pointers
-					fdout.seekg(12 + (modelId * 28), std::ios::beg);
-					fdout.write((char*)&vertPointer, sizeof(DWORD));
-					fdout.write((char*)&vertCount, sizeof(DWORD));
-					fdout.seekg(8, std::ios::cur);
-					fdout.write((char*)&polyPointer, sizeof(DWORD));
-					fdout.write((char*)&polyCount, sizeof(DWORD));
-					
-
-					////1. Write header
-					//fdout.write("\x41\0\0\0", sizeof(DWORD));
-					//fdout.write("\0\0\0\0", 4); //nullVersion
-					//fdout.write((const char*)&currentTmd.objectCount, sizeof(DWORD));
-
-					////2. We now need to iterate through entries and save the data with null pointers
-					//for (int i = 0; i < currentTmd.objectCount; i++)
-					//{
-					//	fdout.write("\0\0\0\0", sizeof(DWORD)); //pointer to verts
-					//	int vertCount = verticesIndex / 6;
-					//	int polyCount = vertCount / 3;
-					//	if (i != modelId)
-					//		fdout.write((const char*)&currentTmd.objects[i].nVerts, sizeof(DWORD));
-					//	else
-					//		fdout.write((const char*)&vertCount, sizeof(DWORD));
-					//	fdout.write("\0\0\0\0", sizeof(DWORD)); //pointer to normals
-					//	fdout.write((const char*)&currentTmd.objects[i].nNorms, sizeof(DWORD));
-					//	fdout.write("\0\0\0\0", sizeof(DWORD)); //pointer to polygons
-					//	if(i!=modelId)
-					//		fdout.write((const char*)&currentTmd.objects[i].nPrims, sizeof(DWORD));
-					//	else
-					//		fdout.write((const char*)&vertCount, sizeof(DWORD));
-					//	fdout.write((const char*)&currentTmd.objects[i].scale, sizeof(DWORD));
-					//}
-
-					////3. We have all needed headers, now simply copy the data
-					//for (int i = 0; i < currentTmd.objectCount; i++)
-					//{
-					//	if (i != modelId) //copy data from opened file
-					//	{
-					//		br.seek(currentTmd.objects[i].pVerts, std::ios::beg); //jump to polyPointer
-					//		
-					//	}
-					//	else //create data by us of modified model
-					//	{
-
-					//	}
-
-					//}
-					//finalize
-					fdout.close();
 				}
+				if (!sSaveReport.empty())
+					ImGui::TextUnformatted(sSaveReport.c_str());
 				if (ImGui::Button("Export modified model"))
 				{
 					std::string exportPath = OpenSaveDialog("Wavefront OBJ (.obj)\0*.obj", "Export path as...");
 					if (exportPath != "NULL")
 					{
-						std::ofstream fdout;
-						fdout.open(exportPath, std::ios::out);
-						for (int i = 0; i < currentTmd.objects[modelId].nVerts; i++)
-						{
-							char localn[256];
-							std::snprintf(localn, 256, "v %f %f %f\n",
-								(float)((double)currentTmd.objects[modelId].vertices[i].x * 100.0f),
-								(float)((double)-currentTmd.objects[modelId].vertices[i].y * 100.0f),
-								(float)((double)currentTmd.objects[modelId].vertices[i].z * 100.0f)
-							);
-							fdout << localn;
-						}
-						for (int i = 0; i < verticesIndex/6; i++)
-						{
-							char localn[256];
-							std::snprintf(localn, 256, "vn %f %f %f\n",
-								vertices[i*6+3],
-								vertices[i*6+4],
-								vertices[i*6+5]
-							);
-							fdout << localn;
-						}
-						int normalPointer = 1;
-						for (int i = 0; i < currentTmd.objects[modelId].nPrims; i++)
-						{
-							char localn[256];
-							std::snprintf(localn, 256, "f %d//%d %d//%d %d//%d\n",
-								currentTmd.objects[modelId].polygon[i].A + 1,
-								normalPointer,
-								currentTmd.objects[modelId].polygon[i].B + 1,
-								normalPointer + 1,
-								currentTmd.objects[modelId].polygon[i].C + 1,
-								normalPointer + 2
-							);
-							normalPointer += 3;
-							fdout << localn;
-						}
-						fdout.close();
-
+						if (!ExportObj(currentTmd.objects[modelId], &vertices[3], 6, verticesIndex / 6, exportPath))
+							MessageBox(NULL, "Couldn't write exported model!", "ERROR", MB_OK);
 					}
-
 				}
 			}
+			if (modelId != -1 && !bIsCustomModel)
+			{
+				if (ImGui::Checkbox("Indexed rendering", &bIndexedRendering))
+					bVertexBufferStale = true;
+				ImGui::Text(sRenderStats.c_str());
+			}
+			if (ImGui::InputInt("Decoded objects budget (MB)", &decodeBudgetMB))
+			{
+				decodeBudgetMB = std::max(decodeBudgetMB, 0);
+				objectCache.SetBudget(currentTmd, (size_t)decodeBudgetMB * 1024 * 1024);
+			}
+			std::snprintf(localn, 256, "Decoded %d of %d objects, %.1f MB", objectCache.DecodedCount(), currentTmd.objectCount,
+				objectCache.UsedBytes() / (1024.0 * 1024.0));
+			ImGui::Text(localn);
+			if (ImGui::InputInt("GPU mesh budget (MB)", &meshBudgetMB))
+			{
+				meshBudgetMB = std::max(meshBudgetMB, 0);
+				meshCache.SetBudget((size_t)meshBudgetMB * 1024 * 1024);
+			}
+			std::snprintf(localn, 256, "Meshes on GPU: %d, %.1f MB", meshCache.Count(), meshCache.UsedBytes() / (1024.0 * 1024.0));
+			ImGui::Text(localn);
+			ImGui::Checkbox("Whole archive view", &bSceneView);
+			if (bSceneView && sceneView.IsBuilt())
+			{
+				std::snprintf(localn, 256, "Drawn %d of %d objects, %d of %d polygons, %.1f MB", sceneView.VisibleCount(),
+					sceneView.ObjectCount(), sceneView.VisibleTriangles(), sceneView.TriangleCount(), sceneView.Bytes() / (1024.0 * 1024.0));
+				ImGui::Text(localn);
+			}
 			ImGui::Separator();
 			for (int i = 0; i < currentTmd.objectCount; i++)
 			{
 				char localName[256];
-				if (currentTmd.objects[i].polygon[0].MODE != 0x31010506)
+				//bodies aren't decoded yet- first primitive tells if object is one the tool can show
+				if (currentTmd.objects[i].nPrims <= 0 || !IsDecodedMode(currentTmd.objects[i].firstMode))
 					continue;
 				std::snprintf(localName, 256, "OBJECT: %d", i);
 				if (ImGui::Button(localName))
 				{
 					OpenRenderModel(i);
+					bSceneView = false;
 				}
 				ImGui::SameLine();
 				std::snprintf(localn, 256, "v: %d, poly: %d", currentTmd.objects[i].nVerts, currentTmd.objects[i].nPrims);
@@ -831,35 +819,19 @@ void ImguiMenu()
 		{
 			ImGui::SetNextWindowPos(ImVec2(width * 0.75f, height * 0.25f));
 			ImGui::SetNextWindowSize(ImVec2(width * 0.25f, height * 0.66f));
-			ImGui::Begin("Pigment editor", NULL, ImGuiWindowFlags_AlwaysAutoResize);
-			if (!bIsCustomModel)
+			//window can't auto resize- it would grow to fit every row and nothing would be clipped
+			ImGui::Begin("Pigment editor", NULL);
+			//one row per polygon corner, only rows on screen are submitted
+			static const char* cornerNames[3] = { "A", "B", "C" };
+			ImGuiListClipper clipper(verticesIndex / 6, ImGui::GetFrameHeightWithSpacing());
+			while (clipper.Step())
 			{
-				for (int i = 0; i < currentTmd.objects[modelId].nPrims * 3; i += 3)
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
 				{
-					char localn[256];
-					std::snprintf(localn, 256, "Poly: %d A", i / 3);
-					ImGui::ColorEdit3(localn, &vertices[i * 6 + 3], ImGuiColorEditFlags_NoAlpha);
-
-					std::snprintf(localn, 256, "Poly: %d B", i / 3);
-					ImGui::ColorEdit3(localn, &vertices[(i + 1) * 6 + 3], ImGuiColorEditFlags_NoAlpha);
-
-					std::snprintf(localn, 256, "Poly: %d C", i / 3);
-					ImGui::ColorEdit3(localn, &vertices[(i + 2) * 6 + 3], ImGuiColorEditFlags_NoAlpha);
-				}
-			}
-			else
-			{
-				for (int i = 0; i < verticesIndex/6; i += 3)
-				{
-					char localn[256];
-					std::snprintf(localn, 256, "Poly: %d A", i / 3);
-					ImGui::ColorEdit3(localn, &vertices[i * 6 + 3], ImGuiColorEditFlags_NoAlpha);
-
-					std::snprintf(localn, 256, "Poly: %d B", i / 3);
-					ImGui::ColorEdit3(localn, &vertices[(i + 1) * 6 + 3], ImGuiColorEditFlags_NoAlpha);
-
-					std::snprintf(localn, 256, "Poly: %d C", i / 3);
-					ImGui::ColorEdit3(localn, &vertices[(i + 2) * 6 + 3], ImGuiColorEditFlags_NoAlpha);
+					char localn[32];
+					std::snprintf(localn, 32, "Poly: %d %s", i / 3, cornerNames[i % 3]);
+					if (ImGui::ColorEdit3(localn, &vertices[i * 6 + 3], ImGuiColorEditFlags_NoAlpha))
+						MarkVerticesDirty(i, 1);
 				}
 			}
 			ImGui::End();
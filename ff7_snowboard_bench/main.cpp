@@ -0,0 +1,328 @@
+/*
+	Final Fantasy VII Snowboard model tool by Maki- benchmarks
+
+	ff7_snowboard_bench tmd [-n runs] file.tmd [file2.tmd ...]
+	Parses every file with the old std::ifstream reader (one read per field) and with the mapped BinaryReader.
+	Both run the same field by field parse ParseTmd does- seek per vertex and polygon- so only the readers
+	are compared. Prints best time of all runs and throughput of both. Files stay in OS cache after the first
+	run, so it's parsing that is measured, not the disk
+
+	ff7_snowboard_bench mesh [-n runs] [-p preset] model.obj|ply|stl [...]
+	Loads every model with the native loader (LoadMeshFile) and with Assimp (ReadScene with import preset
+	and SceneImport flattening, like "Import model" falls back to) into XYZRGB corners. Decimation is
+	left out as both paths share it
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../ff7_snowboard/BinaryReader.h"
+#include "../ff7_snowboard/MeshLoader.h"
+#include "../ff7_snowboard/SceneImport.h"
+
+//std::ifstream backend BinaryReader had before it mapped files, kept here only to be measured against
+class streamReader
+{
+public:
+	streamReader(const std::string& path) : fd(path, std::ios::binary | std::ios::in)
+	{
+	}
+	bool IsOpened() const
+	{
+		return fd.is_open();
+	}
+	bool IsGood() const
+	{
+		return fd.good();
+	}
+	void ReadBuffer(char* c, int count)
+	{
+		fd.read(c, count);
+	}
+	short ReadInt16()
+	{
+		char local[2];
+		fd.read(local, 2);
+		short value;
+		memcpy(&value, local, 2);
+		return value;
+	}
+	unsigned int ReadUInt32()
+	{
+		char local[4];
+		fd.read(local, 4);
+		unsigned int value;
+		memcpy(&value, local, 4);
+		return value;
+	}
+	void seek(int offset, int mode)
+	{
+		fd.seekg(offset, (std::ios::seekdir)mode);
+	}
+
+private:
+	std::ifstream fd;
+};
+
+struct benchVertex
+{
+	float x, y, z, w;
+};
+
+//object as ParseTmd reads it- polygons are fixed 24 byte gouraud triangles
+struct benchObject
+{
+	int pVerts, nVerts, pPrims, nPrims;
+	std::vector<benchVertex> vertices;
+	std::vector<char> polygons;
+};
+
+struct benchTmd
+{
+	std::vector<benchObject> objects;
+	bool bInBounds; //every read was inside of file- stream reads past the end leave garbage
+};
+
+template<typename reader>
+static void ParseFields(reader& br, std::vector<benchObject>& objects)
+{
+	br.seek(4, std::ios::cur);
+	int objectCount = br.ReadUInt32();
+	if (objectCount < 0 || objectCount > (1 << 24))
+		objectCount = 0;
+	objects.clear();
+	objects.resize(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		objects[i].pVerts = br.ReadUInt32();
+		objects[i].nVerts = br.ReadUInt32();
+		br.ReadUInt32();
+		br.ReadUInt32();
+		objects[i].pPrims = br.ReadUInt32();
+		objects[i].nPrims = br.ReadUInt32();
+		br.ReadUInt32();
+		if (objects[i].nVerts < 0 || objects[i].nVerts > (1 << 24))
+			objects[i].nVerts = 0;
+		if (objects[i].nPrims < 0 || objects[i].nPrims > (1 << 24))
+			objects[i].nPrims = 0;
+	}
+	for (benchObject& object : objects)
+	{
+		object.vertices.resize(object.nVerts);
+		for (int k = 0; k < object.nVerts; k++)
+		{
+			br.seek(object.pVerts + k * 8 + 12, std::ios::beg);
+			object.vertices[k].x = br.ReadInt16() / 100.0f;
+			object.vertices[k].y = br.ReadInt16() / 100.0f;
+			object.vertices[k].z = br.ReadInt16() / 100.0f;
+			object.vertices[k].w = br.ReadInt16() / 100.0f;
+		}
+		object.polygons.resize(object.nPrims * 24);
+		for (int k = 0; k < object.nPrims; k++)
+		{
+			br.seek(object.pPrims + k * 24 + 12, std::ios::beg);
+			br.ReadBuffer(&object.polygons[k * 24], 24);
+		}
+	}
+}
+
+static bool ParseStream(const std::string& path, benchTmd& tmd)
+{
+	streamReader br(path);
+	if (!br.IsOpened() || br.ReadUInt32() != 0x41)
+		return false;
+	ParseFields(br, tmd.objects);
+	tmd.bInBounds = br.IsGood();
+	return true;
+}
+
+static bool ParseMapped(const std::string& path, benchTmd& tmd)
+{
+	BinaryReader br(path);
+	if (!br.bIsOpened || br.ReadUInt32() != 0x41)
+		return false;
+	ParseFields(br, tmd.objects);
+	tmd.bInBounds = !br.bOutOfBounds;
+	return true;
+}
+
+//best wall time of runs in seconds, or negative if parse failed
+static double TimeParse(bool (*parse)(const std::string&, benchTmd&), const std::string& path, int runs, benchTmd& tmd)
+{
+	double best = -1.0;
+	for (int i = 0; i < runs; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		if (!parse(path, tmd))
+			return -1.0;
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (best < 0.0 || seconds < best)
+			best = seconds;
+	}
+	return best;
+}
+
+//both readers have to give the same vertices and polygon bytes
+static bool SameResult(const std::vector<benchObject>& a, const std::vector<benchObject>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].vertices.size() != b[i].vertices.size() || a[i].polygons != b[i].polygons)
+			return false;
+		if (!a[i].vertices.empty() && memcmp(a[i].vertices.data(), b[i].vertices.data(), a[i].vertices.size() * sizeof(benchVertex)) != 0)
+			return false;
+	}
+	return true;
+}
+
+static int BenchTmd(const std::vector<std::string>& inputs, int runs)
+{
+	int result = 0;
+	printf("%-32s %8s %10s %10s %11s %11s %8s\n", "file", "MB", "stream ms", "mapped ms", "stream MB/s", "mapped MB/s", "speedup");
+	for (const std::string& path : inputs)
+	{
+		BinaryReader file(path);
+		double megabytes = file.size() / (1024.0 * 1024.0);
+		file = BinaryReader();
+		benchTmd streamTmd, mappedTmd;
+		double stream = TimeParse(ParseStream, path, runs, streamTmd);
+		double mapped = TimeParse(ParseMapped, path, runs, mappedTmd);
+		if (stream < 0.0 || mapped < 0.0)
+		{
+			fprintf(stderr, "%s: couldn't parse file\n", path.c_str());
+			result = 1;
+			continue;
+		}
+		if (!mappedTmd.bInBounds)
+			fprintf(stderr, "%s: file is truncated, decoded data isn't compared\n", path.c_str());
+		else if (!streamTmd.bInBounds || !SameResult(streamTmd.objects, mappedTmd.objects))
+		{
+			fprintf(stderr, "%s: readers disagree on decoded data\n", path.c_str());
+			result = 1;
+		}
+		printf("%-32s %8.2f %10.2f %10.2f %11.1f %11.1f %7.1fx\n", path.c_str(), megabytes, stream * 1000.0, mapped * 1000.0,
+			megabytes / stream, megabytes / mapped, stream / mapped);
+	}
+	return result;
+}
+
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int BenchMesh(const std::vector<std::string>& inputs, int runs, int preset)
+{
+	int result = 0;
+	Assimp::Importer importer;
+	SetupImporter(importer);
+	printf("%-32s %8s %10s %10s %10s %10s %8s\n", "file", "MB", "native ms", "corners", "assimp ms", "corners", "speedup");
+	for (const std::string& path : inputs)
+	{
+		BinaryReader file(path);
+		double megabytes = file.size() / (1024.0 * 1024.0);
+		file = BinaryReader();
+		double native = -1.0, assimp = -1.0;
+		size_t nativeCorners = 0, assimpCorners = 0;
+		std::vector<float> corners;
+		for (int i = 0; i < runs; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			corners.clear();
+			if (!LoadMeshFile(path, corners))
+				break;
+			double seconds = SecondsSince(start);
+			if (native < 0.0 || seconds < native)
+				native = seconds;
+			nativeCorners = corners.size() / 6;
+		}
+		for (int i = 0; i < runs; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			importReport report;
+			const aiScene* scene = ReadScene(importer, path, preset, report);
+			if (scene == NULL)
+				break;
+			SceneImport sceneImport(scene);
+			corners.resize((size_t)sceneImport.CornerCount() * 6);
+			sceneImport.Flatten(corners.data());
+			importer.FreeScene();
+			double seconds = SecondsSince(start);
+			if (assimp < 0.0 || seconds < assimp)
+				assimp = seconds;
+			assimpCorners = corners.size() / 6;
+		}
+		if (native < 0.0)
+		{
+			fprintf(stderr, "%s: native loader doesn't read this file\n", path.c_str());
+			result = 1;
+		}
+		if (assimp < 0.0)
+		{
+			fprintf(stderr, "%s: Assimp couldn't read file: %s\n", path.c_str(), importer.GetErrorString());
+			result = 1;
+		}
+		//path that failed is printed as "-" so the other one is still reported
+		char nativeColumns[32] = "         -          -", assimpColumns[32] = "         -          -", speedup[16] = "       -";
+		if (native >= 0.0)
+			std::snprintf(nativeColumns, sizeof(nativeColumns), "%10.2f %10zu", native * 1000.0, nativeCorners);
+		if (assimp >= 0.0)
+			std::snprintf(assimpColumns, sizeof(assimpColumns), "%10.2f %10zu", assimp * 1000.0, assimpCorners);
+		if (native >= 0.0 && assimp >= 0.0)
+			std::snprintf(speedup, sizeof(speedup), "%7.1fx", assimp / native);
+		printf("%-32s %8.2f %s %s %s\n", path.c_str(), megabytes, nativeColumns, assimpColumns, speedup);
+	}
+	return result;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr, "Usage: ff7_snowboard_bench tmd [-n runs] file.tmd [file2.tmd ...]\n");
+	fprintf(stderr, "       ff7_snowboard_bench mesh [-n runs] [-p preset] model.obj|ply|stl [...]\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+	std::string mode = argv[1];
+	int runs = 5;
+	int preset = 0;
+	std::vector<std::string> inputs;
+	for (int i = 2; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			runs = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+			preset = atoi(argv[++i]);
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+			inputs.push_back(argv[i]);
+	}
+	if (runs < 1)
+		runs = 1;
+	if (inputs.empty() || preset < 0 || preset >= IMPORT_PRESET_COUNT)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (mode == "tmd")
+		return BenchTmd(inputs, runs);
+	if (mode == "mesh")
+		return BenchMesh(inputs, runs, preset);
+	PrintUsage();
+	return 1;
+}
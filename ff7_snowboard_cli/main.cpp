@@ -0,0 +1,129 @@
+/*
+	Final Fantasy VII Snowboard model tool by Maki- headless batch converter
+
+	Converts every object of given TMD files without creating any window or GL context:
+	ff7_snowboard_cli [-f obj|ply|gltf] [-o outputDir] [-j threads] file.tmd [file2.tmd ...]
+	Objects are written as <outputDir>/<tmdName>_<objectId>.<format>
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include "../ff7_snowboard/BinaryReader.h"
+#include "../ff7_snowboard/Tmd.h"
+#include "../ff7_snowboard/TmdExport.h"
+#include "../ff7_snowboard/ParallelFor.h"
+
+struct exportJob
+{
+	const Tmd* tmd;
+	int objectId;
+	std::string path;
+};
+
+static void PrintUsage()
+{
+	fprintf(stderr, "Usage: ff7_snowboard_cli [-f obj|ply|gltf] [-o outputDir] [-j threads] file.tmd [file2.tmd ...]\n");
+}
+
+//file name without directory and extension
+static std::string BaseName(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+	size_t dot = name.find_last_of('.');
+	return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+int main(int argc, char** argv)
+{
+	std::string format = "obj";
+	std::string outputDir;
+	int threadCount = (int)std::thread::hardware_concurrency();
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-f") && i + 1 < argc)
+			format = argv[++i];
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			outputDir = argv[++i];
+		else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+			threadCount = atoi(argv[++i]);
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+			inputs.push_back(argv[i]);
+	}
+	bool (*exporter)(const tmdObject&, const std::string&) = NULL;
+	if (format == "obj")
+		exporter = ExportObj;
+	else if (format == "ply")
+		exporter = ExportPly;
+	else if (format == "gltf")
+		exporter = ExportGltf;
+	if (exporter == NULL || inputs.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (threadCount < 1)
+		threadCount = 1;
+	if (!outputDir.empty() && outputDir.back() != '/' && outputDir.back() != '\\')
+		outputDir.push_back('/');
+
+	int result = 0;
+	std::vector<Tmd> tmds(inputs.size());
+	std::vector<exportJob> jobs;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		BinaryReader br(inputs[i]);
+		if (!br.bIsOpened)
+		{
+			fprintf(stderr, "%s: couldn't open file\n", inputs[i].c_str());
+			result = 1;
+			continue;
+		}
+		std::vector<tmdError> errors;
+		TmdStatus status = ParseTmd(br, tmds[i], errors);
+		if (status == TMD_INVALID_VERSION)
+		{
+			fprintf(stderr, "%s: invalid FFVII TMD file\n", inputs[i].c_str());
+			result = 1;
+			continue;
+		}
+		if (status == TMD_TRUNCATED)
+			fprintf(stderr, "%s: file is truncated, some objects will be empty\n", inputs[i].c_str());
+		for (const tmdError& error : errors)
+			fprintf(stderr, "%s: %s\n", inputs[i].c_str(), DescribeTmdError(error).c_str());
+		std::string baseName = outputDir + BaseName(inputs[i]);
+		for (int k = 0; k < tmds[i].objectCount; k++)
+		{
+			std::string unknownModes = DescribeUnknownModes(k, tmds[i].objects[k]);
+			if (!unknownModes.empty())
+				fprintf(stderr, "%s: %s", inputs[i].c_str(), unknownModes.c_str());
+			jobs.push_back({ &tmds[i], k, baseName + "_" + std::to_string(k) + "." + format });
+		}
+	}
+
+	std::atomic<int> failedJobs(0);
+	std::mutex outputLock;
+	ParallelFor((int)jobs.size(), [&](int job)
+	{
+		if (exporter(jobs[job].tmd->objects[jobs[job].objectId], jobs[job].path))
+			return;
+		failedJobs++;
+		std::lock_guard<std::mutex> lock(outputLock);
+		fprintf(stderr, "%s: couldn't write file\n", jobs[job].path.c_str());
+	}, threadCount);
+
+	printf("Exported %d of %d objects\n", (int)jobs.size() - failedJobs.load(), (int)jobs.size());
+	return failedJobs > 0 ? 1 : result;
+}
@@ -0,0 +1,262 @@
+/*
+	Final Fantasy VII Snowboard model tool by Maki- tests
+
+	ff7_snowboard_tests
+	Runs every test, prints the failed checks and returns 1 if there were any
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+#include "../ff7_snowboard/BinaryReader.h"
+#include "../ff7_snowboard/Tmd.h"
+
+static int failedChecks = 0;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			failedChecks++; \
+		} \
+	} while (0)
+
+static void PutUInt16(unsigned char* p, unsigned short value)
+{
+	p[0] = (unsigned char)(value & 0xFF);
+	p[1] = (unsigned char)(value >> 8);
+}
+
+static void PutUInt32(unsigned char* p, unsigned int value)
+{
+	for (int i = 0; i < 4; i++)
+		p[i] = (unsigned char)(value >> (i * 8));
+}
+
+//vertex as ParseTmd decoded it before the bulk path- one ReadInt16 and division per component
+static vertex ScalarVertex(const unsigned char* p)
+{
+	vertex v;
+	float* xyzw = &v.x;
+	for (int k = 0; k < 4; k++)
+		xyzw[k] = (short)(p[k * 2] | (p[k * 2 + 1] << 8)) / 100.0f;
+	return v;
+}
+
+//DecodeVertices (AVX2 or SSE2 when compiled for it) has to match scalar decode bit for bit
+static void TestDecodeVerticesMatchesScalar()
+{
+	//every int16 value once, then odd counts from unaligned source so SIMD loops leave scalar tails
+	std::vector<unsigned char> src(65536 * 2 + 1);
+	for (int value = 0; value < 65536; value++)
+		PutUInt16(&src[1 + value * 2], (unsigned short)value);
+	for (int offset = 0; offset < 2; offset++)
+	{
+		for (int count : { 0, 1, 2, 3, 5, 7, 9, 16383, 16384 })
+		{
+			if (offset + count * 8 > (int)src.size())
+				continue;
+			std::vector<vertex> decoded(count + 1);
+			const vertex guard = { 1.5f, 2.5f, 3.5f, 4.5f };
+			decoded[count] = guard;
+			DecodeVertices(&src[offset], count, decoded.data());
+			int mismatches = 0;
+			for (int i = 0; i < count; i++)
+			{
+				vertex expected = ScalarVertex(&src[offset + i * 8]);
+				if (memcmp(&expected, &decoded[i], sizeof(vertex)) != 0)
+					mismatches++;
+			}
+			CHECK(mismatches == 0);
+			CHECK(memcmp(&decoded[count], &guard, sizeof(vertex)) == 0); //nothing written past count
+		}
+	}
+}
+
+static bool SameCorner(const TMD_3_NS_GP& poly, int corner, const unsigned char* rgb, unsigned short index)
+{
+	const unsigned char* colors[3] = { &poly.R0, &poly.R1, &poly.R2 };
+	const unsigned short indices[3] = { poly.A, poly.B, poly.C };
+	return memcmp(colors[corner], rgb, 3) == 0 && indices[corner] == index;
+}
+
+//records are built byte by byte as PSX TMD documents them: MODE word (olen, ilen, flag, mode), colors
+//then USHORT vertex indices
+static void TestDecodePolygonLayouts()
+{
+	const unsigned char red[3] = { 200, 10, 20 };
+	const unsigned char green[3] = { 30, 210, 40 };
+	const unsigned char blue[3] = { 50, 60, 220 };
+	const unsigned char white[3] = { 250, 240, 230 };
+
+	//F3- one color for all corners, 16 bytes
+	unsigned char f3[16] = {};
+	PutUInt32(f3, TMD_MODE_3_NS_FP);
+	memcpy(f3 + 4, red, 3);
+	PutUInt16(f3 + 8, 1);
+	PutUInt16(f3 + 10, 2);
+	PutUInt16(f3 + 12, 3);
+	std::vector<TMD_3_NS_GP> polygons;
+	CHECK(DecodePolygons(f3, sizeof(f3), 1, polygons) == 16);
+	CHECK(polygons.size() == 1);
+	if (polygons.size() == 1)
+	{
+		CHECK(polygons[0].MODE == TMD_MODE_3_NS_GP);
+		CHECK(SameCorner(polygons[0], 0, red, 1) && SameCorner(polygons[0], 1, red, 2) && SameCorner(polygons[0], 2, red, 3));
+	}
+
+	//F4- one color, quad V0 V1 V2 V3 is split into V0 V1 V2 and V1 V3 V2, 16 bytes
+	unsigned char f4[16] = {};
+	PutUInt32(f4, TMD_MODE_4_NS_FP);
+	memcpy(f4 + 4, green, 3);
+	PutUInt16(f4 + 8, 4);
+	PutUInt16(f4 + 10, 5);
+	PutUInt16(f4 + 12, 6);
+	PutUInt16(f4 + 14, 7);
+	polygons.clear();
+	CHECK(DecodePolygons(f4, sizeof(f4), 1, polygons) == 16);
+	CHECK(polygons.size() == 2);
+	if (polygons.size() == 2)
+	{
+		CHECK(SameCorner(polygons[0], 0, green, 4) && SameCorner(polygons[0], 1, green, 5) && SameCorner(polygons[0], 2, green, 6));
+		CHECK(SameCorner(polygons[1], 0, green, 5) && SameCorner(polygons[1], 1, green, 7) && SameCorner(polygons[1], 2, green, 6));
+	}
+
+	//G4- color per corner, four colors then four indices, 28 bytes
+	unsigned char g4[28] = {};
+	PutUInt32(g4, TMD_MODE_4_NS_GP);
+	memcpy(g4 + 4, red, 3);
+	memcpy(g4 + 8, green, 3);
+	memcpy(g4 + 12, blue, 3);
+	memcpy(g4 + 16, white, 3);
+	PutUInt16(g4 + 20, 8);
+	PutUInt16(g4 + 22, 9);
+	PutUInt16(g4 + 24, 10);
+	PutUInt16(g4 + 26, 11);
+	polygons.clear();
+	CHECK(DecodePolygons(g4, sizeof(g4), 1, polygons) == 28);
+	CHECK(polygons.size() == 2);
+	if (polygons.size() == 2)
+	{
+		CHECK(SameCorner(polygons[0], 0, red, 8) && SameCorner(polygons[0], 1, green, 9) && SameCorner(polygons[0], 2, blue, 10));
+		CHECK(SameCorner(polygons[1], 0, green, 9) && SameCorner(polygons[1], 1, white, 11) && SameCorner(polygons[1], 2, blue, 10));
+	}
+
+	//G3 run, then unknown record walked by its ilen and kept with own MODE, then F3 again
+	std::vector<unsigned char> mixed(24 * 2);
+	for (int i = 0; i < 2; i++)
+	{
+		unsigned char* g3 = &mixed[i * 24];
+		PutUInt32(g3, TMD_MODE_3_NS_GP);
+		memcpy(g3 + 4, red, 3);
+		memcpy(g3 + 8, green, 3);
+		memcpy(g3 + 12, blue, 3);
+		PutUInt16(g3 + 16, (unsigned short)i);
+		PutUInt16(g3 + 18, (unsigned short)(i + 1));
+		PutUInt16(g3 + 20, (unsigned short)(i + 2));
+	}
+	unsigned char unknown[12] = {};
+	PutUInt32(unknown, 0x25020203); //ilen 2- 12 bytes
+	mixed.insert(mixed.end(), unknown, unknown + sizeof(unknown));
+	mixed.insert(mixed.end(), f3, f3 + sizeof(f3));
+	polygons.clear();
+	CHECK(DecodePolygons(mixed.data(), (int)mixed.size(), 4, polygons) == (int)mixed.size());
+	CHECK(polygons.size() == 4);
+	if (polygons.size() == 4)
+	{
+		CHECK(memcmp(&polygons[0], &mixed[0], 24) == 0 && memcmp(&polygons[1], &mixed[24], 24) == 0);
+		CHECK(polygons[2].MODE == 0x25020203);
+		CHECK(SameCorner(polygons[3], 0, red, 1));
+		tmdObject object;
+		object.polygon = polygons;
+		CHECK(CountUnknownModes(object).size() == 1);
+	}
+
+	//record running past the block
+	polygons.clear();
+	CHECK(DecodePolygons(g4, 27, 1, polygons) == -1);
+	CHECK(DecodePolygons(mixed.data(), 60, 4, polygons) == -1);
+}
+
+//one object TMD with a 4 vertex block and one G3 record right after the table, then table entry is
+//pointed outside of file block by block- each broken block gets its own error and nothing else does
+static void TestObjectErrors()
+{
+	std::vector<unsigned char> file(12 + 28 + 4 * 8 + 24);
+	PutUInt32(&file[0], 0x41);
+	PutUInt32(&file[8], 1);
+	const unsigned int table[7] = { 28, 4, 0, 0, 28 + 32, 1, 0 }; //offsets are from end of header
+	for (int i = 0; i < 7; i++)
+		PutUInt32(&file[12 + i * 4], table[i]);
+	PutUInt32(&file[12 + 28 + 32], TMD_MODE_3_NS_GP);
+
+	struct errorCase
+	{
+		int field; //of table entry, -1 leaves it valid
+		unsigned int value;
+		std::vector<TmdBlock> expected;
+	};
+	const errorCase cases[] = {
+		{ -1, 0, {} },
+		{ 0, 0x100000, { TMD_BLOCK_VERTICES } },
+		{ 1, 1000, { TMD_BLOCK_VERTICES } },
+		{ 4, 0x100000, { TMD_BLOCK_PRIMITIVES } },
+		{ 5, 2, { TMD_BLOCK_PRIMITIVES } },
+		{ 1, 0, {} }, //no vertices- where the block points doesn't matter
+	};
+	for (const errorCase& test : cases)
+	{
+		std::vector<unsigned char> broken = file;
+		if (test.field != -1)
+			PutUInt32(&broken[12 + test.field * 4], test.value);
+		if (test.field == 1 && test.value == 0)
+			PutUInt32(&broken[12], 0x100000);
+		Tmd tmd;
+		std::vector<tmdError> errors;
+		TmdStatus status = ParseTmd(broken.data(), (int)broken.size(), tmd, errors);
+		CHECK(status == (test.expected.empty() ? TMD_OK : TMD_TRUNCATED));
+		CHECK(errors.size() == test.expected.size());
+		for (size_t i = 0; i < errors.size() && i < test.expected.size(); i++)
+			CHECK(errors[i].block == test.expected[i] && errors[i].object == 0);
+	}
+}
+
+//object cache decodes bodies again after evicting them- second decode has to give the same object
+static void TestDecodeObjectTwice()
+{
+	std::vector<unsigned char> file(12 + 28 + 4 * 8 + 24);
+	PutUInt32(&file[0], 0x41);
+	PutUInt32(&file[8], 1);
+	const unsigned int table[7] = { 28, 4, 0, 0, 28 + 32, 1, 0 };
+	for (int i = 0; i < 7; i++)
+		PutUInt32(&file[12 + i * 4], table[i]);
+	PutUInt32(&file[12 + 28 + 32], TMD_MODE_3_NS_GP);
+
+	BinaryReader br(file.data(), (int)file.size());
+	Tmd tmd;
+	std::vector<tmdError> errors;
+	CHECK(ParseTmdTable(br, tmd, errors) == TMD_OK);
+	CHECK(DecodeObject(br, tmd.objects[0]));
+	CHECK(DecodeObject(br, tmd.objects[0]));
+	CHECK(tmd.objects[0].vertices.size() == 4);
+	CHECK(tmd.objects[0].polygon.size() == 1);
+	CHECK(tmd.objects[0].primBlockSize == 24);
+}
+
+int main()
+{
+	TestDecodeVerticesMatchesScalar();
+	TestDecodePolygonLayouts();
+	TestObjectErrors();
+	TestDecodeObjectTwice();
+	if (failedChecks > 0)
+	{
+		fprintf(stderr, "%d checks failed\n", failedChecks);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}